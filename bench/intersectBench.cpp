@@ -0,0 +1,88 @@
+#include "mappedFile.h"
+#include "stlReader.h"
+#include "triangleStore.h"
+
+#include <Nexus.h>
+#include <chrono>
+
+using namespace Nexus;
+
+// Layers per model and passes over them, enough to get stable timings on the
+// models in res/models
+constexpr double LAYER_HEIGHT = 0.2;
+constexpr int PASSES = 5;
+
+struct KernelRun {
+  double seconds = 0.0;
+  size_t planes = 0;
+  std::vector<Line> lines;
+};
+
+static KernelRun run(IntersectKernel kernel, const TriangleStore &triangles,
+                     double bottom, double top) {
+  KernelRun result;
+  std::vector<Line> lines;
+  for (int pass = 0; pass < PASSES; ++pass) {
+    for (double height = bottom + LAYER_HEIGHT / 2; height < top;
+         height += LAYER_HEIGHT) {
+      lines.clear();
+      const auto start = std::chrono::steady_clock::now();
+      intersectTriangles(kernel, triangles, nullptr, triangles.size(), height,
+                         lines);
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      result.seconds += elapsed.count();
+      ++result.planes;
+      if (pass == 0)
+        result.lines.insert(result.lines.end(), lines.begin(), lines.end());
+    }
+  }
+  return result;
+}
+
+// Times the triangle intersection kernels on whole STL models, one plane per
+// layer over the full height, and checks that they agree segment for segment.
+// Usage: intersect-bench <model.stl>...
+int main(int argc, char *argv[]) {
+  Logger::setLevel(LogLevel::Info);
+  ThreadPool threadPool;
+
+  const bool avx2 = getIntersectKernel() == IntersectKernel::AVX2;
+  if (!avx2)
+    Logger::info("AVX2 is not available, timing the scalar kernel only");
+
+  for (int arg = 1; arg < argc; ++arg) {
+    MappedFile file(argv[arg]);
+    StlMesh mesh;
+    if (!file.isOpen() ||
+        !readStl(file.data(), file.size(), threadPool, mesh)) {
+      Logger::error("Could not read {}", argv[arg]);
+      continue;
+    }
+
+    TriangleStore triangles;
+    triangles.reserve(mesh.positions.size() / 3);
+    for (size_t i = 0; i + 2 < mesh.positions.size(); i += 3)
+      triangles.push_back(mesh.positions[i], mesh.positions[i + 1],
+                          mesh.positions[i + 2]);
+
+    const KernelRun scalar =
+        run(IntersectKernel::Scalar, triangles, mesh.min.y, mesh.max.y);
+    const double tested = double(scalar.planes) * triangles.size();
+    Logger::info("{}: {} triangles, {} layers", argv[arg], triangles.size(),
+                 scalar.planes / PASSES);
+    Logger::info("  scalar {:.1f} M triangles/s",
+                 tested / scalar.seconds / 1e6);
+
+    if (avx2) {
+      const KernelRun batched =
+          run(IntersectKernel::AVX2, triangles, mesh.min.y, mesh.max.y);
+      Logger::info("  AVX2   {:.1f} M triangles/s ({:.2f}x)",
+                   tested / batched.seconds / 1e6,
+                   scalar.seconds / batched.seconds);
+      if (batched.lines != scalar.lines)
+        Logger::error("  AVX2 segments differ from the scalar kernel");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "model.h"
+#include "scanline.h"
+#include "slicer.h"
+
+#include <Nexus.h>
+#include <chrono>
+#include <cmath>
+
+using namespace Clipper2Lib;
+using namespace Nexus;
+
+// 20% line infill with 0.4 mm lines, on every layer of 0.2 mm
+constexpr double LAYER_HEIGHT = 0.2;
+constexpr int64_t SPACING = 2000;
+constexpr std::array<double, 2> ANGLES{45.0, 135.0};
+
+// The lines of the pattern crossing `bounds`, as the SLICER_CLIPPER_LINES
+// path hands them to Clipper
+static Paths64 createLines(const Rect64 &bounds, double angle) {
+  Paths64 corners{bounds.AsPath()};
+  rotatePaths(corners, angle);
+  const auto [minX, minY, maxX, maxY] = GetBounds(corners.front());
+
+  Paths64 lines;
+  const int64_t first =
+      static_cast<int64_t>(std::floor(double(minY) / SPACING)) * SPACING;
+  for (int64_t y = first; y <= maxY; y += SPACING)
+    lines.push_back({{minX, y}, {maxX, y}});
+  unRotatePaths(lines, angle);
+  return lines;
+}
+
+static double getLength(const Paths64 &paths) {
+  double length = 0.0;
+  for (const Path64 &path : paths)
+    for (size_t i = 1; i < path.size(); ++i)
+      length += std::hypot(double(path[i].x - path[i - 1].x),
+                           double(path[i].y - path[i - 1].y));
+  return length;
+}
+
+// Clips line infill to every layer contour of each model, once with the
+// scanline kernel and once with Clipper, and compares time and total length.
+// Usage: scanline-bench <model>...
+int main(int argc, char *argv[]) {
+  Logger::setLevel(LogLevel::Info);
+  ThreadPool threadPool;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    Model model(argv[arg], threadPool);
+    model.setPosition(glm::vec3(0.0f));
+    model.setRotation(glm::vec3(0.0f));
+    model.setScale(glm::vec3(1.0f));
+
+    const auto [min, max] = model.getWorldBounds();
+    std::vector<double> heights;
+    for (double height = min.y + LAYER_HEIGHT / 2; height < max.y;
+         height += LAYER_HEIGHT)
+      heights.push_back(height);
+    const std::vector<Slice> slices = model.getSlices(heights, threadPool);
+
+    double scanlineSeconds = 0.0, clipperSeconds = 0.0;
+    double scanlineLength = 0.0, clipperLength = 0.0;
+    Clipper64 clipper;
+    for (const Slice &slice : slices) {
+      const Paths64 &area = slice.getContour();
+      if (area.empty())
+        continue;
+
+      for (double angle : ANGLES) {
+        Paths64 result;
+        auto start = std::chrono::steady_clock::now();
+        clipLines(result, area, FillRule::NonZero, angle, 0, SPACING);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        scanlineSeconds += elapsed.count();
+        scanlineLength += getLength(result);
+
+        // Line generation is left out, the pattern cache provides the lines
+        const Paths64 lines = createLines(GetBounds(area), angle);
+        result.clear();
+        Paths64 discard;
+        start = std::chrono::steady_clock::now();
+        clipper.Clear();
+        clipper.AddOpenSubject(lines);
+        clipper.AddClip(area);
+        clipper.Execute(ClipType::Intersection, FillRule::NonZero, discard,
+                        result);
+        elapsed = std::chrono::steady_clock::now() - start;
+        clipperSeconds += elapsed.count();
+        clipperLength += getLength(result);
+      }
+    }
+
+    Logger::info("{}: {} layers", argv[arg], slices.size());
+    Logger::info("  scanline {:.2f} ms, Clipper {:.2f} ms ({:.2f}x)",
+                 scanlineSeconds * 1000.0, clipperSeconds * 1000.0,
+                 clipperSeconds / scanlineSeconds);
+    Logger::info("  infill length {:.1f} mm vs {:.1f} mm",
+                 scanlineLength / 1000.0, clipperLength / 1000.0);
+  }
+  return 0;
+}
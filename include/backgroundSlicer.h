@@ -0,0 +1,61 @@
+#pragma once
+
+#include "jobProgress.h"
+#include "jobSettings.h"
+#include "layerFeed.h"
+#include "slicer.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs the slicing and g-code export jobs of one Slicer on a background
+// thread, one job at a time. Finished slices are published as a SliceResult
+// snapshot, so readers keep the last result while the next one is sliced.
+// Jobs are started and cancelled from a single thread, which must not touch
+// the slicer or its model while isBusy() returns true. The same thread
+// consumes the layers a running slice publishes to getFeed().
+class BackgroundSlicer {
+public:
+  explicit BackgroundSlicer(Slicer &slicer) : m_slicer(slicer) {}
+  // Cancels the running job and waits for it
+  ~BackgroundSlicer();
+  BackgroundSlicer(const BackgroundSlicer &) = delete;
+  BackgroundSlicer &operator=(const BackgroundSlicer &) = delete;
+
+  // All return false and do nothing while a job is running. The export
+  // slices first, which only runs the stages that are not up to date.
+  bool startSlice(const PipelineSettings &settings);
+  bool startExport(std::string path, const JobSettings &job);
+  // Computes one layer through Slicer::getSlice, leaving the others alone,
+  // and publishes it to the feed. Layers past the last one preview the last.
+  bool startPreview(const PipelineSettings &settings, size_t index);
+  void cancel() { m_progress.cancel(); }
+
+  bool isBusy() const { return m_busy.load(std::memory_order_acquire); }
+  const JobProgress &getProgress() const { return m_progress; }
+  // Layers of the running slice, emptied when the next job starts
+  LayerFeed &getFeed() { return m_feed; }
+
+  // The last finished slice, null before the first one
+  std::shared_ptr<const SliceResult> getResult() const;
+  // Drops the result, for when the model is replaced
+  void clearResult();
+
+private:
+  bool start(std::function<void()> job);
+  // Slices and publishes the result, null once cancelled
+  std::shared_ptr<const SliceResult> runSlice(const PipelineSettings &settings);
+
+  Slicer &m_slicer;
+  JobProgress m_progress;
+  LayerFeed m_feed;
+  std::atomic<bool> m_busy{false};
+  std::thread m_thread;
+
+  mutable std::mutex m_resultMutex;
+  std::shared_ptr<const SliceResult> m_result;
+};
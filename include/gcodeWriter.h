@@ -1,6 +1,8 @@
 #pragma once
 
 #include "clipper2/clipper.core.h"
+#include "jobSettings.h"
+#include "pathBuffer.h"
 #include "slice.h"
 #include "slicer.h"
 #include <fstream>
@@ -10,18 +12,29 @@
 
 class GcodeWriter {
 public:
-  GcodeWriter(const char *filename, const Slicer &slicer);
+  // Writes the slices with the layer height and nozzle diameter they were
+  // sliced with. Every layer is a step of `progress`, writing stops once it is
+  // cancelled.
+  GcodeWriter(const char *filename, const SliceResult &result,
+              const PrintSettings &settings, JobProgress *progress = nullptr);
 
 private:
   void NewGcodeFile(const char *filename);
   void WriteHeader();
   void WriteSlice(const Slice &slice);
-  void WritePaths(const Clipper2Lib::PathsD &paths, float speed);
-  void WritePath(const Clipper2Lib::PathD &path, float speed);
+  void WritePaths(const PathBuffer &paths, float speed);
+  void WriteGroup(const PathBuffer &paths, size_t group, float speed);
+  void WritePath(PathBuffer::PathView path, float speed);
   void WriteFooter();
   void CloseGcodeFile();
 
   std::ofstream m_file;
+  const PrintSettings m_settings;
+  float m_layerThickness;
+  float m_nozzleDiameter;
+  // Speeds of the layer being written
+  float m_wallSpeed;
+  float m_infillSpeed;
   float extrusion;
   float layerHeight;
   Clipper2Lib::PointD currentPosition;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit FNV-1a, plus a word-wise mode for bulk data (see addWords). Values
+// are hashed field by field, never as whole structs, so padding bytes do not
+// end up in the hash.
+class Fnv1a {
+public:
+  void add(const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      m_value ^= bytes[i];
+      m_value *= PRIME;
+    }
+  }
+
+  template <typename T>
+    requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+  void add(T value) {
+    add(&value, sizeof(value));
+  }
+
+  // Large buffers are folded in eight bytes at a time, which is several
+  // times faster than hashing them byte by byte. A plain xor and multiply
+  // per word would only carry differences towards the high bits, so every
+  // step goes through a full 64-bit mixer instead.
+  void addWords(const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i, sizeof(word));
+      m_value = mix(m_value ^ word);
+    }
+    add(bytes + i, size - i);
+  }
+
+  uint64_t get() const { return m_value; }
+
+private:
+  // MurmurHash3's fmix64, a bijection in which every input bit affects every
+  // output bit
+  static uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+  }
+
+  static constexpr uint64_t PRIME = 0x100000001b3ull;
+  uint64_t m_value = 0xcbf29ce484222325ull;
+};
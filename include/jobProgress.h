@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Progress of a running job, split into tasks of countable steps such as the
+// layers of one stage. Written by the job, read and cancelled from any
+// thread.
+class JobProgress {
+public:
+  void reset() {
+    m_task.store("", std::memory_order_relaxed);
+    m_stepsDone.store(0, std::memory_order_relaxed);
+    m_stepCount.store(0, std::memory_order_relaxed);
+    m_cancelled.store(false, std::memory_order_relaxed);
+  }
+
+  void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+  bool isCancelled() const {
+    return m_cancelled.load(std::memory_order_relaxed);
+  }
+
+  // `name` has to outlive the job, usually it is a literal. A step count of
+  // zero marks a task whose length is not known up front.
+  void beginTask(const char *name, size_t stepCount) {
+    m_stepsDone.store(0, std::memory_order_relaxed);
+    m_stepCount.store(stepCount, std::memory_order_relaxed);
+    m_task.store(name, std::memory_order_relaxed);
+  }
+  // Counts one step of the current task. Returns false once the job is
+  // cancelled, the step should then be skipped.
+  bool step() {
+    if (isCancelled())
+      return false;
+    m_stepsDone.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  const char *getTaskName() const {
+    return m_task.load(std::memory_order_relaxed);
+  }
+  size_t getStepsDone() const {
+    return m_stepsDone.load(std::memory_order_relaxed);
+  }
+  size_t getStepCount() const {
+    return m_stepCount.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<const char *> m_task{""};
+  std::atomic<size_t> m_stepsDone{0};
+  std::atomic<size_t> m_stepCount{0};
+  std::atomic<bool> m_cancelled{false};
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "slicer.h"
+
+// Printer settings only read when writing g-code. Speeds are in mm/s.
+struct PrintSettings {
+  int bedTemp = 50;
+  int nozzleTemp = 200;
+  float infillSpeed = 50.0f;
+  float wallSpeed = 25.0f;
+  // Replaces both speeds on the first two layers
+  float initialLayerSpeed = 10.0f;
+  float retractDistance = 5.0f;
+  // Travel moves shorter than this are not retracted
+  float minimumRetractDistance = 1.5f;
+};
+
+// Everything one slicing job reads besides its model. Jobs only take it by
+// const reference or by value and the engine has no global state, so any
+// number of jobs can run side by side, each with its own Slicer.
+struct JobSettings {
+  PipelineSettings pipeline;
+  PrintSettings print;
+};
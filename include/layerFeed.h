@@ -0,0 +1,47 @@
+#pragma once
+
+#include "slice.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// Hands the paths of finished layers from the slicing threads to a single
+// consumer without locks. Only the path types a stage changed are sent, the
+// consumer merges them into its own copy of the layer. Producers push onto a
+// Treiber stack with one CAS, the consumer takes the whole stack with one
+// exchange, so it never pops single nodes and the stack is free of ABA
+// problems.
+class LayerFeed {
+public:
+  struct Layer {
+    size_t index;
+    size_t layerCount;
+    Slice::PathType type;
+    PathBuffer paths;
+  };
+
+  LayerFeed() = default;
+  ~LayerFeed() { clear(); }
+  LayerFeed(const LayerFeed &) = delete;
+  LayerFeed &operator=(const LayerFeed &) = delete;
+
+  // Called from any thread
+  void publish(size_t index, size_t layerCount, Slice::PathType type,
+               PathBuffer paths);
+
+  // Called from the consumer thread only. Passes every layer published since
+  // the last call to `consume`, in the order they were published, so a later
+  // copy of a layer's paths always comes after an earlier one.
+  void drain(const std::function<void(Layer &)> &consume);
+  // Drops the pending layers
+  void clear();
+
+private:
+  struct Node {
+    Layer layer;
+    Node *next;
+  };
+
+  std::atomic<Node *> m_head{nullptr};
+};
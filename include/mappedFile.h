@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The pages are only read from disk
+// when they are touched and the mapping is released on destruction.
+class MappedFile {
+public:
+  explicit MappedFile(const char *path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool isOpen() const { return m_data != nullptr; }
+  const char *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  const char *m_data = nullptr;
+  size_t m_size = 0;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "model.h"
+#include "shader.h"
+
+#include <glm/glm.hpp>
+
+// GPU copy of a model's mesh, flat shaded. Must be used from the thread
+// owning the GL context.
+class MeshRenderer {
+public:
+  MeshRenderer() = default;
+  explicit MeshRenderer(const Model &model) { upload(model); }
+  ~MeshRenderer();
+  MeshRenderer(const MeshRenderer &) = delete;
+  MeshRenderer &operator=(const MeshRenderer &) = delete;
+
+  // Replaces the uploaded mesh, the transform is read from the model when it
+  // is rendered
+  void upload(const Model &model);
+  void render(const Model &model, Shader &shader, const glm::mat4 &view,
+              const glm::mat4 &projection, const glm::vec3 &color) const;
+
+private:
+  GLuint m_VAO = 0, m_VBO = 0, m_normalVBO = 0;
+  GLsizei m_vertexCount = 0;
+};
@@ -1,37 +1,26 @@
 #pragma once
 
-#include "shader.h"
+#include "jobProgress.h"
 #include "slice.h"
+#include "threadPool.h"
+#include "triangleStore.h"
+#include "workspace.h"
 
 #include <assimp/scene.h>
 #include <cstddef>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <utility>
 #include <vector>
 
-struct Vertex {
-  glm::vec3 position;
-  glm::vec3 normal;
-};
-
-struct Triangle {
-  std::array<glm::vec3, 3> vertices;
-
-  Triangle(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3);
-
-  float getYmin() const;
-  float getYmax() const;
-
-  glm::vec3 operator[](int i) const;
-};
-
 class Model {
 public:
-  Model(const char *path);
+  // Binary and ASCII STL files are memory-mapped and parsed on `threadPool`,
+  // other formats are loaded through Assimp
+  Model(const char *path, ThreadPool &threadPool);
+  // Loads a model held in memory, such as the embedded resources, serially
   Model(const char *data, size_t length);
 
-  void render(Shader &shader, const glm::mat4 &view,
-              const glm::mat4 &projection, const glm::vec3 &color);
-
   glm::vec3 getMin() const;
   glm::vec3 getMax() const;
   glm::vec3 getCenter() const;
@@ -47,30 +36,71 @@ public:
   float *getScalePtr();
 
   float getHeight();
+  // Corners of the world-space bounding box, in millimetres
+  std::pair<glm::vec3, glm::vec3> getWorldBounds();
   size_t getLayerCount(float layerheight) const;
+  // Hash of the welded mesh, independent of the transform. Computed on the
+  // first call.
+  uint64_t getContentHash();
 
-  Slice getSlice(double sliceHeight);
+  // The welded mesh in model space, drawn by a MeshRenderer
+  const std::vector<glm::vec3> &getPositions() const { return m_positions; }
+  const std::vector<uint32_t> &getIndices() const { return m_indices; }
+  glm::mat4 getModelMatrix() const;
 
-private:
-  std::vector<Vertex> m_vertices;
-  std::vector<GLuint> m_indices;
-  std::vector<Triangle> m_triangles;
+  // Both count every layer towards the Slices stage of `counters`, if given
+  Slice getSlice(double sliceHeight, StageCounters *counters = nullptr);
+  // Slices the model at every height in `sliceHeights`, which must be sorted
+  // in ascending order. Each triangle is only intersected with the layers it
+  // spans. Layers are split into contiguous ranges that are swept in parallel.
+  // Every layer is a step of `progress`, the layers left once it is cancelled
+  // stay empty.
+  std::vector<Slice> getSlices(const std::vector<double> &sliceHeights,
+                               ThreadPool &threadPool,
+                               JobProgress *progress = nullptr,
+                               StageCounters *counters = nullptr);
 
-  glm::vec3 m_min;
-  glm::vec3 m_max;
-  glm::vec3 m_center;
+private:
+  // Welded model-space positions, shared by the triangles in m_indices.
+  // Facet normals are only computed for the upload and not kept.
+  std::vector<glm::vec3> m_positions;
+  std::vector<uint32_t> m_indices;
+
+  // For every triangle edge (i, i + 1) the neighbouring triangle and its
+  // matching edge, packed as `triangle * 3 + edge`
+  std::vector<std::array<uint32_t, 3>> m_adjacency;
+  bool m_isManifold = false;
+
+  // m_positions in world space, rebuilt when the transform changes. The
+  // triangle store the kernels need is built from it for each slicing run.
+  std::vector<glm::vec3> m_worldPositions;
+  glm::vec3 m_worldPosition;
+  glm::vec3 m_worldRotation;
+  glm::vec3 m_worldScale;
+  glm::vec3 m_worldMin;
+  glm::vec3 m_worldMax;
+  bool m_worldValid = false;
+
+  glm::vec3 m_min{0.0f};
+  glm::vec3 m_max{0.0f};
+  glm::vec3 m_center{0.0f};
   glm::vec3 m_position;
   glm::vec3 m_rotation;
   glm::vec3 m_scale;
 
+  uint64_t m_contentHash = 0;
+  bool m_hasContentHash = false;
+
   bool m_hasColor;
-  unsigned int m_VAO, m_VBO, m_EBO;
 
 private:
-  void initOpenGLBuffers();
+  bool processStl(const char *data, size_t length, ThreadPool &threadPool);
+  bool processScene(const aiScene *scene);
   void processVertices(const aiMesh *mesh);
   void processIndices(const aiMesh *mesh);
-  void processTriangles();
-  Triangle transformTriangle(const Triangle &triangle) const;
-  glm::mat4 getModelMatrix() const;
+  void processWelding(ThreadPool &threadPool);
+  void processAdjacency();
+  const std::vector<glm::vec3> &getWorldPositions();
+  TriangleStore getWorldTriangles();
+  size_t getTriangleCount() const { return m_indices.size() / 3; }
 };
\ No newline at end of file
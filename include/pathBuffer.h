@@ -0,0 +1,50 @@
+#pragma once
+
+#include <clipper2/clipper.core.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Paths stored back to back in a single point buffer, with tables of where
+// every path and every group of paths ends. A group is one Paths64 as it was
+// appended, such as a single wall or fill region.
+class PathBuffer {
+  using Point64 = Clipper2Lib::Point64;
+  using Paths64 = Clipper2Lib::Paths64;
+
+public:
+  using PathView = std::span<const Point64>;
+
+  void append(const Paths64 &paths);
+  void clear();
+
+  bool empty() const { return m_groupEnds.empty(); }
+  size_t getGroupCount() const { return m_groupEnds.size(); }
+  size_t getPathCount() const { return m_pathEnds.size(); }
+  const std::vector<Point64> &getPoints() const { return m_points; }
+
+  size_t getPathBegin(size_t path) const {
+    return path == 0 ? 0 : m_pathEnds[path - 1];
+  }
+  size_t getPathEnd(size_t path) const { return m_pathEnds[path]; }
+  PathView getPath(size_t path) const {
+    return PathView(m_points).subspan(getPathBegin(path),
+                                      getPathEnd(path) - getPathBegin(path));
+  }
+
+  // Half-open range of the paths in `group`
+  std::pair<size_t, size_t> getGroupRange(size_t group) const {
+    return {group == 0 ? 0 : m_groupEnds[group - 1], m_groupEnds[group]};
+  }
+  // Copies `group` out for Clipper
+  Paths64 getGroup(size_t group) const;
+
+private:
+  std::vector<Point64> m_points;
+  // One past the last point of every path
+  std::vector<uint32_t> m_pathEnds;
+  // One past the last path of every group
+  std::vector<uint32_t> m_groupEnds;
+};
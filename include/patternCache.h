@@ -0,0 +1,55 @@
+#pragma once
+
+#include <clipper2/clipper.core.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+// Parallel lines `spacing` apart at `angle` degrees, covering a rectangle.
+// Line k lies at `firstOffset + k * spacing` along the rotated y axis (see
+// rotatePaths) and runs across the whole rectangle.
+// Only the SLICER_CLIPPER_LINES path clips these lines, the scanline kernel
+// gets by with PatternCache::getOffset.
+struct LinePattern {
+  double angle;
+  int64_t spacing;
+  int64_t firstOffset;
+  Clipper2Lib::Paths64 lines;
+
+  // Half-open range of the lines that can cross `bounds`
+  std::pair<size_t, size_t> getRange(const Clipper2Lib::Rect64 &bounds) const;
+};
+
+// Unclipped line patterns shared by every layer of a model. Patterns are laid
+// over the model bounds and anchored to their centre, so a layer only has to
+// clip the lines crossing its area. Safe to use from several threads.
+class PatternCache {
+  using Rect64 = Clipper2Lib::Rect64;
+
+public:
+  // Drops all patterns and lays new ones over `bounds`
+  void reset(const Rect64 &bounds);
+
+  // Offset along the rotated y axis of a line through the anchor moved by
+  // `phase`. Every line of the pattern with these parameters lies at this
+  // offset plus a multiple of the spacing, whatever area it is clipped to.
+  int64_t getOffset(double angle, int64_t phase);
+
+  // Returns the pattern with lines offset by `phase` (modulo `spacing`) from
+  // the anchor. Areas reaching past the cached bounds get a pattern of their
+  // own, aligned with the cached ones.
+  std::shared_ptr<const LinePattern> getLines(const Rect64 &areaBounds,
+                                              double angle, int64_t spacing,
+                                              int64_t phase);
+
+private:
+  std::mutex m_mutex;
+  Rect64 m_bounds;
+  Clipper2Lib::Point64 m_anchor;
+  std::map<std::tuple<double, int64_t, int64_t>,
+           std::shared_ptr<const LinePattern>>
+      m_patterns;
+};
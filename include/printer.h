@@ -2,6 +2,7 @@
 #include <glm/glm.hpp>
 
 #include "glm/fwd.hpp"
+#include "meshRenderer.h"
 #include "model.h"
 
 class Printer {
@@ -23,6 +24,8 @@ public:
 private:
   Model m_base;
   Model m_slicePlane;
+  MeshRenderer m_baseRenderer;
+  MeshRenderer m_slicePlaneRenderer;
 
   float m_nozzle;
   glm::ivec3 m_size;
@@ -21,7 +21,7 @@ void main()
     Normal = mat3(transpose(inverse(model))) * aNormal;
 })";
 static const char *sliceVertexShader = R"(#version 410 core
-layout (location = 0) in dvec2 aPos;
+layout (location = 0) in vec2 aPos;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -29,7 +29,7 @@ uniform mat4 model;
 
 void main()
 {
-    vec4 pos = vec4(float(aPos.x),  0.0, float(aPos.y), 1.0);
+    vec4 pos = vec4(aPos.x,  0.0, aPos.y, 1.0);
     gl_Position = projection * view * model * pos; 
 })";
 static const char *baseFragmentShader = R"(#version 410 core
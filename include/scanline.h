@@ -0,0 +1,16 @@
+#pragma once
+
+#include <clipper2/clipper.core.h>
+#include <cstdint>
+
+// Clips a family of parallel lines to `area` without a general polygon
+// clipper. The lines are horizontal in the frame rotated by `angle` degrees
+// (see rotatePaths) and line k lies at `firstOffset + k * spacing` there.
+//
+// The edges of `area` are rotated once and bucketed by the lines they cross.
+// The crossings of every line are then sorted and swept with `fillRule`, and
+// the spans inside the area are appended to `result` in line order, each
+// running towards increasing rotated x.
+void clipLines(Clipper2Lib::Paths64 &result, const Clipper2Lib::Paths64 &area,
+               Clipper2Lib::FillRule fillRule, double angle,
+               int64_t firstOffset, int64_t spacing);
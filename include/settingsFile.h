@@ -0,0 +1,9 @@
+#pragma once
+
+#include "state.h"
+
+// Reads `key = value` lines into `state`. Keys are the field names of the
+// slice, printer and file settings; enums take their numeric value. Empty
+// lines and lines starting with '#' are skipped. Returns false and logs the
+// first line that could not be read.
+bool loadSettingsFile(const char *path, State &state);
@@ -1,23 +1,19 @@
 #pragma once
 
-#include "shader.h"
+#include "pathBuffer.h"
+#include "stage.h"
 
+#include <array>
 #include <clipper2/clipper.core.h>
 #include <clipper2/clipper.h>
+#include <cstdint>
+#include <span>
 #include <glm/fwd.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <sys/types.h>
-#include <unordered_map>
 #include <vector>
 
-#define GREEN glm::vec3(0.0f, 1.0f, 0.0f)
-#define YELLOW glm::vec3(1.0f, 1.0f, 0.0f)
-#define BLUE glm::vec3(0.0f, 0.0f, 1.0f)
-#define BLUEGREEN glm::vec3(0.0f, 1.0f, 1.0f)
-#define RED glm::vec3(1.0f, 0.0f, 0.0f)
-#define ORANGE glm::vec3(1.0f, 0.5f, 0.0f)
-
 struct Line {
   Clipper2Lib::PointD p1, p2;
   void setNextPoint(Clipper2Lib::PointD point);
@@ -27,70 +23,104 @@ private:
   bool firstPointSet = false;
 };
 
+// Geometry is stored in integer micron coordinates (see MM2INT) so every
+// slicer stage can hand it to Clipper without converting. It is converted to
+// millimetres only when it is rendered or written out as g-code.
+//
+// Every kind of toolpath lives in its own PathBuffer, so a slice is a handful
+// of contiguous allocations and cheap to move. Slices are plain geometry and
+// never touch OpenGL, the preview draws them through a SliceRenderer.
 class Slice {
   using PathsD = Clipper2Lib::PathsD;
   using PathD = Clipper2Lib::PathD;
+  using Paths64 = Clipper2Lib::Paths64;
+  using Path64 = Clipper2Lib::Path64;
 
-  struct PathData {
-    std::vector<PathsD> paths;
-    std::vector<uint> VAOs;
-  };
-
+public:
+  // In drawing order
   enum PathType {
-    InnerWall,
     OuterWall,
+    InnerWall,
     Skin,
     Infill,
     Support,
+    Adhesion,
+    PathTypeCount,
   };
 
-public:
   Slice() = default;
   Slice(std::vector<Line> &lineSegments);
+  // Builds the slice from contours (in millimetres) that are already closed
+  Slice(const PathsD &contours);
   std::pair<glm::vec2, glm::vec2> getBounds() const;
 
-  void render(Shader &shader, const glm::vec3 &position,
-              const float &scale) const;
-
-  void clear();
-
+  // The contour the slice was built from, read by the walls
+  const Paths64 &getContour() const { return m_contour; }
+  void setContour(Paths64 contour) { m_contour = std::move(contour); }
+
+  // Each drops what one pipeline stage added, so the stage can run again
+  void clearWalls();
+  void clearFill();
+  void clearInfill();
+  void clearSupport();
+  void clearAdhesion();
+  // Calls the one above for `stage`, the slices stage drops the contour
+  void clearStage(Stage stage);
+
+  void addPaths(PathType type, const Paths64 &paths);
+  // Replaces all paths of `type`
+  void setPaths(PathType type, PathBuffer paths);
+  // The path types `stage` adds, none for the slices stage
+  static std::span<const PathType> getStagePathTypes(Stage stage);
   // assumes the shell is closed
-  void addOuterWall(const PathsD &wall);
-  void addInnerWall(const PathsD &shell);
-  void addFill(const PathsD &fill);
-  void setFillArea(const PathsD &fillArea) { m_fillArea = fillArea; }
-  void addInfill(const PathsD &infill);
-  void addSupport(const PathsD &support);
-  void setSupportArea(const PathsD supportArea) { m_supportArea = supportArea; }
-
-  bool hasPerimeter() const { return m_paths.contains(OuterWall); }
-  bool hasWalls() const { return m_paths.contains(InnerWall); }
-  bool hasFill() const { return m_paths.contains(Skin); }
-  bool hasInfill() const { return m_paths.contains(Infill); }
-  bool hasSupport() const { return m_paths.contains(Support); }
-
-  const PathsD &getPerimeter() const;
-  const PathD getOuterMostPerimeter() const;
-  const std::vector<PathsD> &getShells() const;
-  const PathsD &getInnermostShell() const;
-  const std::vector<PathsD> &getFill() const;
-  const PathsD &getFillArea() const { return m_fillArea; }
-  const std::vector<PathsD> &getInfill() const;
-  const std::vector<PathsD> &getSupport() const;
-  void removeSupport();
-  const PathsD &getSupportArea() const { return m_supportArea; }
+  void addOuterWall(const Paths64 &wall);
+  void addInnerWall(const Paths64 &shell);
+  void addFill(const Paths64 &fill);
+  void setFillArea(Paths64 fillArea) { m_fillArea = std::move(fillArea); }
+  void addInfill(const Paths64 &infill);
+  void addSupport(const Paths64 &support);
+  void setSupportArea(Paths64 supportArea) {
+    m_supportArea = std::move(supportArea);
+  }
+  void addAdhesion(const Paths64 &adhesion);
+
+  bool hasPerimeter() const { return !m_paths[OuterWall].empty(); }
+  bool hasWalls() const { return !m_paths[InnerWall].empty(); }
+  bool hasFill() const { return !m_paths[Skin].empty(); }
+  bool hasInfill() const { return !m_paths[Infill].empty(); }
+  bool hasSupport() const { return !m_paths[Support].empty(); }
+  bool hasAdhesion() const { return !m_paths[Adhesion].empty(); }
+
+  const PathBuffer &getPaths(PathType type) const { return m_paths[type]; }
+  // Changes whenever paths of `type` are added or cleared. Revisions are
+  // unique across all slices, so a copy of the paths tagged with one is
+  // current exactly when the revision still matches.
+  uint64_t getRevision(PathType type) const { return m_revisions[type]; }
+
+  // The first outer wall group, copied out for Clipper
+  Paths64 getPerimeter() const;
+  const Path64 getOuterMostPerimeter() const;
+  const PathBuffer &getShells() const { return m_paths[InnerWall]; }
+  // The last inner wall group, copied out for Clipper
+  Paths64 getInnermostShell() const;
+  const PathBuffer &getFill() const { return m_paths[Skin]; }
+  const Paths64 &getFillArea() const { return m_fillArea; }
+  const PathBuffer &getInfill() const { return m_paths[Infill]; }
+  const PathBuffer &getSupport() const { return m_paths[Support]; }
+  const Paths64 &getSupportArea() const { return m_supportArea; }
+  const PathBuffer &getAdhesion() const { return m_paths[Adhesion]; }
 
 private:
-  const double EPSILON = 1e-3;
+  static constexpr double EPSILON = 1e-3;
 
-  std::unordered_map<PathType, PathData> m_paths;
+  std::array<PathBuffer, PathTypeCount> m_paths;
+  std::array<uint64_t, PathTypeCount> m_revisions{};
 
-  PathsD m_supportArea;
-  PathsD m_fillArea;
+  Paths64 m_contour;
+  Paths64 m_supportArea;
+  Paths64 m_fillArea;
 
 private:
-  void initOpenGLBuffers(std::vector<uint> &VAOs, const PathsD &paths);
-  uint initOpenGLBuffer(const PathD &path);
-  void drawPaths(const PathData &pd, Shader &shader, glm::vec3 color) const;
-  void drawPath(const PathD &path, uint vaoIndex) const;
-};
\ No newline at end of file
+  void clearPaths(PathType type);
+  void touch(PathType type);
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "shader.h"
+#include "slice.h"
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#define GREEN glm::vec3(0.0f, 1.0f, 0.0f)
+#define YELLOW glm::vec3(1.0f, 1.0f, 0.0f)
+#define BLUE glm::vec3(0.0f, 0.0f, 1.0f)
+#define BLUEGREEN glm::vec3(0.0f, 1.0f, 1.0f)
+#define RED glm::vec3(1.0f, 0.0f, 0.0f)
+#define ORANGE glm::vec3(1.0f, 0.5f, 0.0f)
+
+// GPU copy of the slice on screen. Every path type is uploaded when the
+// revision of the rendered slice differs from the uploaded one, so switching
+// layers or re-slicing only re-uploads what changed. Must be used from the
+// thread owning the GL context.
+class SliceRenderer {
+public:
+  SliceRenderer() = default;
+  ~SliceRenderer();
+  SliceRenderer(const SliceRenderer &) = delete;
+  SliceRenderer &operator=(const SliceRenderer &) = delete;
+
+  void render(const Slice &slice, Shader &shader, const glm::vec3 &position,
+              float scale);
+
+private:
+  // GL copy of one PathBuffer, drawn as line strips in one call
+  struct GLBuffer {
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    uint64_t revision = 0;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+  };
+
+  void upload(const Slice &slice, Slice::PathType type);
+  void draw(Slice::PathType type, Shader &shader, glm::vec3 color) const;
+
+  std::array<GLBuffer, Slice::PathTypeCount> m_buffers;
+};
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "jobProgress.h"
+#include "layerFeed.h"
 #include "model.h"
+#include "patternCache.h"
 #include "slice.h"
+#include "stage.h"
+#include "stageCache.h"
+#include "threadPool.h"
+#include "workspace.h"
 
 #include <clipper2/clipper.core.h>
+#include <array>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
 inline void rotatePaths(Clipper2Lib::PathsD &paths, float angle) {
@@ -110,6 +122,74 @@ enum BrimLocation {
   BrimLocationCount,
 };
 
+// Inputs of every pipeline stage. A stage re-runs when its inputs changed or
+// when a stage it reads from re-ran. The model transform is an input of the
+// slices as well and is read from the model itself.
+struct SliceStageSettings {
+  float layerHeight = 0.2f;
+  float nozzleDiameter = 0.4f;
+  bool operator==(const SliceStageSettings &) const = default;
+};
+
+struct WallStageSettings {
+  int shellCount = 2;
+  bool operator==(const WallStageSettings &) const = default;
+};
+
+struct FillStageSettings {
+  FillType fillType = LinesFill;
+  int floorCount = 4;
+  int roofCount = 4;
+  bool operator==(const FillStageSettings &) const = default;
+};
+
+struct InfillStageSettings {
+  InfillType infillType = Cubic;
+  // Between 0 and 1, no infill is generated at 0
+  float density = 0.2f;
+  bool operator==(const InfillStageSettings &) const = default;
+};
+
+struct SupportStageSettings {
+  bool enabled = true;
+  SupportType supportType = GridSupport;
+  float density = 0.2f;
+  size_t wallCount = 1;
+  size_t brimWallCount = 10;
+  bool operator==(const SupportStageSettings &) const = default;
+};
+
+struct AdhesionStageSettings {
+  AdhesionTypes adhesionType = Skirt;
+  BrimLocation brimLocation = Outside;
+  int brimLineCount = 20;
+  int skirtLineCount = 3;
+  int skirtHeight = 3;
+  float skirtDistance = 10.0f;
+  bool operator==(const AdhesionStageSettings &) const = default;
+};
+
+struct PipelineSettings {
+  SliceStageSettings slices;
+  WallStageSettings walls;
+  FillStageSettings fill;
+  InfillStageSettings infill;
+  SupportStageSettings support;
+  AdhesionStageSettings adhesion;
+  // Offsets every line pattern, in microns. An input of the fill, infill and
+  // support.
+  int64_t extraShift = 0;
+  bool operator==(const PipelineSettings &) const = default;
+};
+
+// The output of one finished slice() call. Published as a snapshot that
+// never changes, so other threads can keep reading it while the slicer runs
+// again.
+struct SliceResult {
+  PipelineSettings settings;
+  std::vector<Slice> slices;
+};
+
 class Slicer {
   using Paths64 = Clipper2Lib::Paths64;
 
@@ -119,22 +199,39 @@ public:
   void loadModel(const char *modelPath);
   Model &getModel() { return *m_model; };
   void init(float layerHeight, float nozzleDiameter);
+  void setWorkerCount(size_t workerCount);
+  // Stage outputs are loaded from and stored in `directory`, an empty path
+  // disables the cache
+  void setCache(std::filesystem::path directory, uint64_t maxBytes);
 
   int getLayerCount() const { return m_layerCount; }
   bool hasSlices() const { return m_slices.size() > 0; }
 
-  const Slice &getSlice(size_t index) const { return m_slices.at(index); }
-
-  void createSlices();
-  void createWalls(int wallCount);
-  void createFill(FillType fillType, int floorCount, int roofCount);
-  void createInfill(InfillType infillType, float density);
-  void createSupport(SupportType supportType, float density, size_t wallCount,
-                     size_t brimWallCount);
+  // Lazy alternative to slice() for inspecting a few layers: records
+  // `settings` and drops the outputs they invalidate without computing any
+  // layer. Stages found in the cache are loaded whole. getSlice() checks
+  // `progress` for cancellation until the next prepare() or slice().
+  void prepare(const PipelineSettings &settings,
+               JobProgress *progress = nullptr);
+  // Computes the stages layer `index` misses on first use, along with the
+  // layers they read: the floor and roof windows of the fill, the layers
+  // above it for the support and the first layer for the adhesion. Results
+  // are kept until the settings change, and slice() only runs the stages
+  // that are not done for every layer. Once cancelled the layer holds the
+  // stages done so far.
+  const Slice &getSlice(size_t index);
 
-  // Adhesion
-  void createBrim(BrimLocation brimLocation, int lineCount);
-  void createSkirt(int lineCount, int height, float distance);
+  // Brings the slices up to date with `settings`, running only the stages
+  // whose inputs changed since the last call and the stages depending on them.
+  // Every stage is a task of `progress` with a step per layer. Returns false
+  // when `progress` was cancelled, the next call then runs every stage.
+  // Layers are published to `feed` from the worker threads as soon as a stage
+  // is done with them.
+  bool slice(const PipelineSettings &settings,
+             JobProgress *progress = nullptr, LayerFeed *feed = nullptr);
+  // Copy of the slices of the last successful slice() call, null while any
+  // layer misses a stage
+  std::shared_ptr<const SliceResult> getResult() const;
 
   const char *fillTypes[FillType::FillCount]{"None", "Concentric", "Lines"};
   const char *infillTypes[InfillType::InfillCount]{
@@ -144,48 +241,132 @@ public:
   const char *supportTypes[SupportType::SupportCount]{
       "None", "Lines", "Grid", "Triangles", "Concentric"};
 
-  int64_t extraShift;
-
 private:
-  int64_t getLineDistance(uint lineCount, float density) const;
+  void runStage(Stage stage, const PipelineSettings &settings);
+  // Stages whose inputs changed since the last run and the stages reading
+  // them, as stage bits
+  uint32_t getDirtyStages(const PipelineSettings &settings) const;
+  // Whether the inputs of `stage` differ from its last run
+  bool hasChanged(Stage stage, const PipelineSettings &settings) const;
+  bool isCancelled() const { return m_progress && m_progress->isCancelled(); }
+  // Called before the work on every layer, false once cancelled
+  bool beginLayer() const { return !m_progress || m_progress->step(); }
+  // Runs `task` for every layer on the thread pool and publishes the paths
+  // of `stage` of each layer once its task returned
+  void forEachLayer(Stage stage, const std::function<void(size_t)> &task);
+  // Hands a copy of the paths `stage` made on the layer to the feed of the
+  // running slice() call
+  void publishLayer(size_t index, Stage stage) const;
+  // Cache keys covering the inputs of every stage and of everything it reads
+  std::array<uint64_t, STAGE_COUNT>
+  getStageKeys(const PipelineSettings &settings);
 
-  int64_t getShiftOffsetFromInfillOriginAndRotation(const Paths64 &area,
-                                                    const double angle);
+  bool isStageComplete(Stage stage) const;
+  // Records `stage` as done for the layers in [first, last)
+  void markStage(Stage stage, size_t first, size_t last);
+  std::vector<size_t> getMissingLayers(Stage stage, size_t first,
+                                       size_t last) const;
 
-  void generateFill(Paths64 &fillResult, FillType fillType, const double angle);
+  // Lazy stages for getSlice(). Each computes its stage for the layers in
+  // [first, last) that miss it, after the layers they read.
+  void ensureSlices(size_t first, size_t last);
+  void ensureWalls(size_t first, size_t last);
+  void ensureFill(size_t first, size_t last);
+  void ensureInfill(size_t first, size_t last);
+  // From the top layer down to `first`
+  void ensureSupport(size_t first);
+  void ensureAdhesion(size_t first, size_t last);
 
-  void generateLineInfill(Paths64 &infillResult, const int64_t lineDistance,
-                          const double angle, int64_t shift);
-  void generateGridInfill(Paths64 &infillResult, const int64_t lineDistance,
-                          const double angle);
+  double getSliceHeight(size_t layer) const;
+  void createSlices();
+  void resetPatternCache();
+  void createWalls(int wallCount);
+  void createFill(FillType fillType, int floorCount, int roofCount);
+  void createInfill(InfillType infillType, float density);
+  // The first layer gets no support when it is covered by a brim
+  void createSupport(SupportType supportType, float density, size_t wallCount,
+                     size_t brimWallCount, bool firstLayerSupport);
 
-  void generateCubicInfill(Paths64 &infillResult, const int64_t lineDistance,
-                           const double angle);
+  // One layer of the stages above, shared with getSlice(). `below` and
+  // `above` are the intersections of the floor and roof windows around the
+  // layer, and the support reads the finished layer above.
+  void createLayerWalls(size_t i, int wallCount);
+  void createLayerFill(size_t i, FillType fillType, size_t floorCount,
+                       size_t roofCount, const Paths64 &shell,
+                       const Paths64 &below, const Paths64 &above);
+  void createLayerInfill(size_t layer, InfillType infillType, float density);
+  void createLayerSupport(size_t i, SupportType supportType, float density,
+                          size_t wallCount, size_t brimCount,
+                          bool firstLayerSupport);
 
-  void generateTriangleInfill(Paths64 &infillResult, const int64_t lineDistance,
-                              const double angle);
-  void generateTriHexagonInfill(Paths64 &infillResult,
-                                const int64_t lineDistance, const double angle);
-  void generateTetrahedralInfill(Paths64 &infillResult,
-                                 const int64_t lineDistance);
-  void generateQuarterCubicInfill(Paths64 &infillResult,
-                                  const int64_t lineDistance);
+  // Adhesion
+  void createBrim(BrimLocation brimLocation, int lineCount);
+  void createSkirt(int lineCount, int height, float distance);
+
+  int64_t getLineDistance(uint lineCount, float density) const;
+
+  // The generators append the pattern clipped to `area` to the result. They
+  // only read settings, so any number of layers can be generated at once.
+  void generateFill(Paths64 &fillResult, const Paths64 &area,
+                    FillType fillType, const double angle) const;
+
+  void generateLineInfill(Paths64 &infillResult, const Paths64 &area,
+                          const int64_t lineDistance, const double angle,
+                          int64_t shift) const;
+  void generateGridInfill(Paths64 &infillResult, const Paths64 &area,
+                          const int64_t lineDistance, const double angle) const;
+
+  void generateCubicInfill(Paths64 &infillResult, const Paths64 &area,
+                           size_t layer, const int64_t lineDistance,
+                           const double angle) const;
+
+  void generateTriangleInfill(Paths64 &infillResult, const Paths64 &area,
+                              const int64_t lineDistance,
+                              const double angle) const;
+  void generateTriHexagonInfill(Paths64 &infillResult, const Paths64 &area,
+                                const int64_t lineDistance,
+                                const double angle) const;
+  void generateTetrahedralInfill(Paths64 &infillResult, const Paths64 &area,
+                                 size_t layer,
+                                 const int64_t lineDistance) const;
+  void generateQuarterCubicInfill(Paths64 &infillResult, const Paths64 &area,
+                                  size_t layer,
+                                  const int64_t lineDistance) const;
   void generateHalfTetrahedralInfill(Paths64 &infillResult,
+                                     const Paths64 &area, size_t layer,
                                      const int64_t lineDistance,
-                                     const double angle, const double zShift);
-  void generateConcentricInfill(Paths64 &infillResult,
-                                const int64_t lineDistance);
+                                     const double angle,
+                                     const double zShift) const;
+  void generateConcentricInfill(Paths64 &infillResult, const Paths64 &area,
+                                const int64_t lineDistance) const;
 
 private:
+  // Declared before the model, which is loaded on it. Mutable so the const
+  // generators can spread their work over it.
+  mutable ThreadPool m_threadPool;
   std::unique_ptr<Model> m_model;
   std::vector<Slice> m_slices;
+  // Stages done for every layer, as stage bits
+  std::vector<uint32_t> m_layerStages;
+  // Filled in by the const generators, it locks internally
+  mutable PatternCache m_patternCache;
+  StageCache m_cache;
+  // Allocation statistics of this slicer's stages, updated by const code too
+  mutable StageCounters m_stageCounters;
 
   size_t m_layerCount = 0;
   float m_layerHeight;
   int64_t m_lineWidth;
   int64_t m_shift;
 
-  Paths64 m_currentArea;
-  size_t m_currentLayer;
-  double m_infillLineDistance;
+  int64_t m_extraShift = 0;
+  // Only set while slice() runs
+  JobProgress *m_progress = nullptr;
+  LayerFeed *m_feed = nullptr;
+
+  // Inputs of the last run, empty until every stage has run once
+  std::optional<PipelineSettings> m_settings;
+  glm::vec3 m_slicedPosition;
+  glm::vec3 m_slicedRotation;
+  glm::vec3 m_slicedScale;
 };
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Stages of the slicing pipeline, in the order they run
+enum class Stage {
+  Slices,
+  Walls,
+  Fill,
+  Infill,
+  Support,
+  Adhesion,
+  Count,
+};
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+
+inline const char *getStageName(Stage stage) {
+  switch (stage) {
+  case Stage::Slices:
+    return "Slices";
+  case Stage::Walls:
+    return "Walls";
+  case Stage::Fill:
+    return "Fill";
+  case Stage::Infill:
+    return "Infill";
+  case Stage::Support:
+    return "Support";
+  case Stage::Adhesion:
+    return "Adhesion";
+  default:
+    return "Unknown";
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "slice.h"
+#include "stage.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+struct StageCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t bytesRead = 0;
+  uint64_t bytesWritten = 0;
+  uint64_t evictions = 0;
+};
+
+// Stage outputs stored on disk under a key covering everything that produced
+// them (see Slicer::slice), so repeated jobs load them instead of slicing
+// again. Every entry is one file. Loading an entry refreshes its modification
+// time, and the least recently used entries are deleted once the directory
+// grows past the size limit. The directory is only scanned when it is set and
+// when entries have to be evicted, in between its size is tracked from the
+// entries written.
+class StageCache {
+public:
+  // An empty directory disables the cache
+  void setDirectory(std::filesystem::path directory, uint64_t maxBytes);
+  bool isEnabled() const { return !m_directory.empty(); }
+
+  // Replaces the output of `stage` in `slices` with the cached one. The entry
+  // has to hold the same number of layers as `slices`.
+  bool load(Stage stage, uint64_t key, std::vector<Slice> &slices);
+  void store(Stage stage, uint64_t key, const std::vector<Slice> &slices);
+
+  const StageCacheStats &getStats() const { return m_stats; }
+  void logStats() const;
+
+  // $XDG_CACHE_HOME/slicer, falling back to ~/.cache/slicer
+  static std::filesystem::path getDefaultDirectory();
+
+private:
+  std::filesystem::path getPath(Stage stage, uint64_t key) const;
+  void remove(const std::filesystem::path &path);
+  // Measures the directory, deleting abandoned temporary files, and evicts
+  // entries until it fits the size limit
+  void evict();
+
+  std::filesystem::path m_directory;
+  uint64_t m_maxBytes = 0;
+  uint64_t m_totalBytes = 0;
+  StageCacheStats m_stats;
+};
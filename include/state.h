@@ -1,8 +1,10 @@
 #pragma once
 
+#include "jobSettings.h"
 #include "slice.h"
 #include "slicer.h"
 #include <clipper2/clipper.h>
+#include <thread>
 #include <vector>
 
 struct State {
@@ -39,6 +41,10 @@ struct State {
     int skirtLineCount = 3;
     float skirtDistance = 10.0f;
 
+    int extraShift = 0;
+
+    int workerCount = std::max(1u, std::thread::hardware_concurrency());
+
   } sliceSettings;
   struct {
     bool dropDown = true;
@@ -47,6 +53,8 @@ struct State {
     bool showDemoWindow = false;
     glm::ivec2 windowSize{1920, 1080};
     bool showSlicePlane = false;
+    // Slices only the viewed layer instead of running every stage
+    bool lazyPreview = false;
     bool sliceViewFocused = false;
     bool modelViewFocused = false;
     float sliceScale = 5.0f;
@@ -60,18 +68,56 @@ struct State {
     float infillSpeed = printSpeed;
     float wallSpeed = printSpeed * 0.5;
     float inititalLayerSpeed = printSpeed * 0.2;
+    // The model is centered on the bed when slicing without the GUI, which
+    // takes the size from the Printer instead
+    int bedWidth = 235;
+    int bedDepth = 235;
   } printerSettings;
 
   struct {
     char inputFile[256] = "../res/models/cube.stl";
     char outputFile[256] = "output.gcode";
-
+    bool useCache = true;
+    int cacheSizeMB = 1024;
   } fileSettings;
 
   struct {
     std::vector<PathsD> supportAreas;
     std::vector<Slice> slices;
   } data;
+
+  JobSettings getJobSettings() const {
+    JobSettings job;
+    auto &pipeline = job.pipeline;
+    pipeline.slices = {sliceSettings.layerHeight,
+                       printerSettings.nozzleDiameter};
+    pipeline.walls = {sliceSettings.shellCount};
+    pipeline.fill = {sliceSettings.fillType, sliceSettings.floorCount,
+                     sliceSettings.roofCount};
+    pipeline.infill = {sliceSettings.infillType,
+                       sliceSettings.infillDensity / 100.0f};
+    pipeline.support = {sliceSettings.enableSupport, sliceSettings.supportType,
+                        sliceSettings.infillDensity / 100.0f,
+                        static_cast<size_t>(sliceSettings.supportWallCount),
+                        static_cast<size_t>(sliceSettings.supportBrimCount)};
+    pipeline.adhesion = {sliceSettings.adhesionType,
+                         sliceSettings.brimLocation,
+                         sliceSettings.brimLineCount,
+                         sliceSettings.skirtLineCount,
+                         sliceSettings.skirtHeight,
+                         sliceSettings.skirtDistance};
+    pipeline.extraShift = sliceSettings.extraShift;
+
+    auto &print = job.print;
+    print.bedTemp = printerSettings.bedTemp;
+    print.nozzleTemp = printerSettings.nozzleTemp;
+    print.infillSpeed = printerSettings.infillSpeed;
+    print.wallSpeed = printerSettings.wallSpeed;
+    print.initialLayerSpeed = printerSettings.inititalLayerSpeed;
+    print.retractDistance = sliceSettings.retractDistance;
+    print.minimumRetractDistance = sliceSettings.minimumRetractDistance;
+    return job;
+  }
 };
 
 extern State g_state;
\ No newline at end of file
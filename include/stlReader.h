@@ -0,0 +1,24 @@
+#pragma once
+
+#include "threadPool.h"
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Corners of the facets of an STL file with y and z swapped, so y is up like
+// everywhere else in the slicer. Every facet gets three positions of its own,
+// centred on the bounding box `min`..`max`. Stored normals are ignored.
+struct StlMesh {
+  std::vector<glm::vec3> positions;
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// True if `data` looks like a binary or ASCII STL
+bool isStl(const char *data, size_t length);
+
+// Parses an STL held in memory. Binary files are split into chunks of facet
+// records that are parsed in parallel. Returns false if the file is malformed.
+bool readStl(const char *data, size_t length, ThreadPool &threadPool,
+             StlMesh &mesh);
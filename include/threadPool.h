@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute index ranges in parallel. The
+// thread calling parallelFor takes part in the work, so a pool with a worker
+// count of one runs everything on the calling thread.
+class ThreadPool {
+public:
+  // A worker count of zero uses one worker per hardware thread
+  explicit ThreadPool(size_t workerCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void setWorkerCount(size_t workerCount);
+  size_t getWorkerCount() const { return m_workers.size() + 1; }
+
+  // Calls `task(i)` for every i in [0, count) and blocks until all calls have
+  // returned. Calls made from inside a task run serially on that thread.
+  void parallelFor(size_t count, const std::function<void(size_t)> &task);
+
+private:
+  void start(size_t workerCount);
+  void stop();
+  void workerLoop(uint64_t generation);
+  void runTasks();
+
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_submitMutex;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  const std::function<void(size_t)> *m_task = nullptr;
+  size_t m_taskCount = 0;
+  std::atomic<size_t> m_nextTask = 0;
+  size_t m_busyWorkers = 0;
+  uint64_t m_generation = 0;
+  bool m_stopping = false;
+};
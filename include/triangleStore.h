@@ -0,0 +1,52 @@
+#pragma once
+
+#include "slice.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Structure-of-arrays triangle storage. Every coordinate of every corner has
+// its own contiguous lane and the vertical extent of each triangle is stored
+// alongside, so the intersection kernel can load several triangles at once.
+struct TriangleStore {
+  std::array<std::vector<float>, 3> x;
+  std::array<std::vector<float>, 3> y;
+  std::array<std::vector<float>, 3> z;
+  std::vector<float> yMin;
+  std::vector<float> yMax;
+
+  size_t size() const { return yMin.size(); }
+  void clear();
+  void reserve(size_t count);
+  void push_back(const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &v3);
+
+  glm::vec3 corner(uint32_t triangle, int corner) const {
+    return {x[corner][triangle], y[corner][triangle], z[corner][triangle]};
+  }
+};
+
+// Intersection kernels. Both produce the same segments in the same order,
+// the AVX2 one tests eight triangles per iteration.
+enum class IntersectKernel { Scalar, AVX2 };
+
+// AVX2 on x86-64 CPUs that support it, the scalar loop everywhere else
+IntersectKernel getIntersectKernel();
+
+// Appends the segments where the triangles `ids[0..count)` cross the plane at
+// `sliceHeight` to `lineSegments`, in the order of `ids`. Triangles that miss
+// the plane or give a degenerate segment are skipped.
+void intersectTriangles(const TriangleStore &triangles, const uint32_t *ids,
+                        size_t count, double sliceHeight,
+                        std::vector<Line> &lineSegments);
+// Same as above for every triangle in the store
+void intersectTriangles(const TriangleStore &triangles, double sliceHeight,
+                        std::vector<Line> &lineSegments);
+// Same as the first with a given kernel, for the benchmarks. `ids` may be
+// null for the first `count` triangles of the store. The AVX2 kernel needs
+// getIntersectKernel() to return it.
+void intersectTriangles(IntersectKernel kernel, const TriangleStore &triangles,
+                        const uint32_t *ids, size_t count, double sliceHeight,
+                        std::vector<Line> &lineSegments);
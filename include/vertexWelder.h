@@ -0,0 +1,20 @@
+#pragma once
+
+#include "threadPool.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Merges positions that round to the same cell of a grid with spacing
+// `tolerance`, and cells whose first positions are at most `tolerance` apart,
+// so close positions on either side of a cell border are merged as well.
+// Merging is transitive, a weld can span more than `tolerance` when many
+// positions are lined up. Every position is mapped to its welded vertex in
+// `ids`, and `firstVertex` holds the first input position of every welded
+// vertex.
+// Welded vertices are numbered in order of first use, so the result does not
+// depend on the number of workers.
+void weldVertices(const std::vector<glm::vec3> &positions, float tolerance,
+                  ThreadPool &threadPool, std::vector<uint32_t> &ids,
+                  std::vector<uint32_t> &firstVertex);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "stage.h"
+
+#include <array>
+#include <atomic>
+#include <clipper2/clipper.engine.h>
+#include <clipper2/clipper.offset.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for temporaries that live no longer than one layer.
+// Deallocation is a no-op, memory is reclaimed by reset(), which keeps a
+// single block as large as everything handed out before it.
+class Arena : public std::pmr::memory_resource {
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void reset();
+  // Bytes handed out since the last reset
+  size_t getUsedBytes() const { return m_used; }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept
+      override {
+    return this == &other;
+  }
+
+  static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+  std::vector<Block> m_blocks;
+  size_t m_offset = 0; // into the last block
+  size_t m_used = 0;
+};
+
+// Scratch state owned by one thread and reused by every layer it handles, so
+// the per-layer stages stop constructing Clipper engines for every call. The
+// helpers are self-contained; code using `clipper` or `offset` directly must
+// be done with them before calling anything that may use them too.
+struct Workspace {
+  Arena arena;
+  Clipper2Lib::Clipper64 clipper;
+  Clipper2Lib::ClipperOffset offset;
+  size_t layerDepth = 0;
+
+  static Workspace &get();
+
+  // Same as Clipper2's BooleanOp and InflatePaths with default settings
+  Clipper2Lib::Paths64 clip(Clipper2Lib::ClipType clipType,
+                            Clipper2Lib::FillRule fillRule,
+                            const Clipper2Lib::Paths64 &subject,
+                            const Clipper2Lib::Paths64 &clip);
+  Clipper2Lib::Paths64 inflate(const Clipper2Lib::Paths64 &paths,
+                               double delta, Clipper2Lib::JoinType joinType,
+                               Clipper2Lib::EndType endType);
+};
+
+// Allocation counts are only collected when built with SLICER_ALLOC_STATS,
+// the arena usage is always tracked. Peaks are the largest of any one layer.
+struct StageStats {
+  uint64_t layers = 0;
+  uint64_t allocations = 0;
+  uint64_t allocatedBytes = 0;
+  uint64_t peakBytes = 0;
+  uint64_t arenaPeakBytes = 0;
+};
+
+// Per-stage statistics of one slicer, added to from any thread by the
+// LayerScopes of its layers
+class StageCounters {
+public:
+  StageStats get(Stage stage) const;
+  // Logs the statistics of `stage` since the last call and resets them
+  void log(Stage stage);
+
+private:
+  friend class LayerScope;
+
+  struct Counters {
+    std::atomic<uint64_t> layers = 0;
+    std::atomic<uint64_t> allocations = 0;
+    std::atomic<uint64_t> allocatedBytes = 0;
+    std::atomic<uint64_t> peakBytes = 0;
+    std::atomic<uint64_t> arenaPeakBytes = 0;
+  };
+  std::array<Counters, STAGE_COUNT> m_stages;
+};
+
+// Marks the work on one layer of `stage` on the calling thread. The outermost
+// scope on a thread resets its arena and adds the allocations made until it
+// ends to `counters`, unless that is null.
+class LayerScope {
+public:
+  LayerScope(StageCounters *counters, Stage stage);
+  ~LayerScope();
+  LayerScope(const LayerScope &) = delete;
+  LayerScope &operator=(const LayerScope &) = delete;
+
+private:
+  StageCounters *m_counters;
+  Stage m_stage;
+  bool m_outermost;
+  uint64_t m_allocations;
+  uint64_t m_allocatedBytes;
+  int64_t m_liveBytes;
+};
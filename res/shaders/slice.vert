@@ -1,5 +1,5 @@
 #version 410 core
-layout (location = 0) in dvec2 aPos;
+layout (location = 0) in vec2 aPos;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -7,6 +7,6 @@ uniform mat4 model;
 
 void main()
 {
-    vec4 pos = vec4(float(aPos.x),  0.0, float(aPos.y), 1.0);
+    vec4 pos = vec4(aPos.x,  0.0, aPos.y, 1.0);
     gl_Position = projection * view * model * pos; 
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "backgroundSlicer.h"
+#include "gcodeWriter.h"
+
+#include <Nexus.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+BackgroundSlicer::~BackgroundSlicer() {
+  cancel();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+bool BackgroundSlicer::start(std::function<void()> job) {
+  if (isBusy())
+    return false;
+  if (m_thread.joinable())
+    m_thread.join();
+
+  m_progress.reset();
+  m_feed.clear();
+  m_busy.store(true, std::memory_order_relaxed);
+  m_thread = std::thread([this, job = std::move(job)]() {
+    job();
+    m_busy.store(false, std::memory_order_release);
+  });
+  return true;
+}
+
+std::shared_ptr<const SliceResult>
+BackgroundSlicer::runSlice(const PipelineSettings &settings) {
+  const auto start = std::chrono::steady_clock::now();
+  if (!m_slicer.slice(settings, &m_progress, &m_feed)) {
+    Nexus::Logger::info("Slicing cancelled");
+    return nullptr;
+  }
+
+  // Copied outside the lock, readers only wait for the pointer swap
+  auto result = m_slicer.getResult();
+  {
+    std::lock_guard lock(m_resultMutex);
+    m_result = result;
+  }
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  Nexus::Logger::info("Slicing complete in {} ms", elapsed.count() * 1000.0);
+  return result;
+}
+
+bool BackgroundSlicer::startSlice(const PipelineSettings &settings) {
+  return start([this, settings]() { runSlice(settings); });
+}
+
+bool BackgroundSlicer::startPreview(const PipelineSettings &settings,
+                                    size_t index) {
+  return start([this, settings, index]() {
+    // The layers a single slice needs depend on what is already done
+    m_progress.beginTask("Slicing the viewed layer", 0);
+    m_slicer.prepare(settings, &m_progress);
+    const size_t layerCount = m_slicer.getLayerCount();
+    if (layerCount == 0)
+      return;
+
+    const size_t layer = std::min(index, layerCount - 1);
+    const Slice &slice = m_slicer.getSlice(layer);
+    if (m_progress.isCancelled())
+      return;
+    for (size_t i = 0; i < Slice::PathTypeCount; ++i) {
+      const auto type = static_cast<Slice::PathType>(i);
+      m_feed.publish(layer, layerCount, type, slice.getPaths(type));
+    }
+  });
+}
+
+bool BackgroundSlicer::startExport(std::string path, const JobSettings &job) {
+  return start([this, path = std::move(path), job]() {
+    const auto result = runSlice(job.pipeline);
+    if (!result)
+      return;
+
+    GcodeWriter writer(path.c_str(), *result, job.print, &m_progress);
+    if (m_progress.isCancelled()) {
+      // Never leave a truncated file behind
+      std::error_code error;
+      std::filesystem::remove(path, error);
+      Nexus::Logger::info("Export to {} cancelled", path);
+      return;
+    }
+    Nexus::Logger::info("Exported g-code to {}", path);
+  });
+}
+
+std::shared_ptr<const SliceResult> BackgroundSlicer::getResult() const {
+  std::lock_guard lock(m_resultMutex);
+  return m_result;
+}
+
+void BackgroundSlicer::clearResult() {
+  std::lock_guard lock(m_resultMutex);
+  m_result.reset();
+}
@@ -0,0 +1,63 @@
+#include "gcodeWriter.h"
+#include "settingsFile.h"
+#include "slicer.h"
+#include "state.h"
+
+#include <Nexus.h>
+#include <chrono>
+
+using namespace Nexus;
+
+void usage(const char *program) {
+  Logger::info("Usage: {} <model> <settings file> <output file>", program);
+}
+
+// Slices a model without a window or GL context and writes its g-code
+int main(int argc, char *argv[]) {
+  Logger::setLevel(LogLevel::Info);
+
+  if (argc != 4) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *modelPath = argv[1];
+  const char *settingsPath = argv[2];
+  const char *outputPath = argv[3];
+
+  State state{};
+  if (!loadSettingsFile(settingsPath, state))
+    return 1;
+  const JobSettings job = state.getJobSettings();
+
+  const auto start = std::chrono::steady_clock::now();
+
+  Slicer slicer(modelPath);
+  slicer.setWorkerCount(state.sliceSettings.workerCount);
+  slicer.setCache(state.fileSettings.useCache
+                      ? StageCache::getDefaultDirectory()
+                      : std::filesystem::path(),
+                  uint64_t(state.fileSettings.cacheSizeMB) * 1024 * 1024);
+
+  // Centered on the bed and resting on it, as the GUI places it
+  Model &model = slicer.getModel();
+  model.setPosition({state.printerSettings.bedWidth / 2.0f,
+                     model.getHeight() / 2.0f,
+                     state.printerSettings.bedDepth / 2.0f});
+
+  if (!slicer.slice(job.pipeline) || !slicer.getResult()) {
+    Logger::error("Slicing {} failed", modelPath);
+    return 1;
+  }
+  if (!slicer.hasSlices()) {
+    Logger::error("Slicing {} produced no layers", modelPath);
+    return 1;
+  }
+
+  GcodeWriter writer(outputPath, *slicer.getResult(), job.print);
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  Logger::info("Wrote {} layers to {} in {} ms", slicer.getLayerCount(),
+               outputPath, elapsed.count() * 1000.0);
+  return 0;
+}
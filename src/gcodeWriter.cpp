@@ -1,35 +1,39 @@
 #include "gcodeWriter.h"
-#include "state.h"
 #include "utils.h"
 
 #include <clipper2/clipper.core.h>
 #include <iomanip>
 #include <ios>
 
-GcodeWriter::GcodeWriter(const char *filepath, const Slicer &slicer) {
+GcodeWriter::GcodeWriter(const char *filepath, const SliceResult &result,
+                         const PrintSettings &settings, JobProgress *progress)
+    : m_settings(settings),
+      m_layerThickness(result.settings.slices.layerHeight),
+      m_nozzleDiameter(result.settings.slices.nozzleDiameter) {
   extrusion = 0;
-  layerHeight = g_state.sliceSettings.layerHeight;
+  layerHeight = m_layerThickness;
 
-  float infillspeed = g_state.printerSettings.infillSpeed;
-  float wallspeed = g_state.printerSettings.wallSpeed;
-  g_state.printerSettings.infillSpeed =
-      g_state.printerSettings.inititalLayerSpeed;
-  g_state.printerSettings.wallSpeed =
-      g_state.printerSettings.inititalLayerSpeed;
+  m_wallSpeed = m_settings.initialLayerSpeed;
+  m_infillSpeed = m_settings.initialLayerSpeed;
 
-  NewGcodeFile("output.gcode");
+  NewGcodeFile(filepath);
   WriteHeader();
   m_file << "M107 ;turn off fan\n";
-  m_file << ";LAYER_COUNT:" << slicer.getLayerCount() << "\n";
-  for (int i = 0; i < slicer.getLayerCount(); i++) {
+  const size_t layerCount = result.slices.size();
+  if (progress)
+    progress->beginTask("G-code", layerCount);
+  m_file << ";LAYER_COUNT:" << layerCount << "\n";
+  for (size_t i = 0; i < layerCount; i++) {
+    if (progress && !progress->step())
+      break;
     m_file << ";LAYER:" << i << "\n";
-    layerHeight = g_state.sliceSettings.layerHeight * (i + 1);
+    layerHeight = m_layerThickness * (i + 1);
     if (i == 2) {
       m_file << "M106 S255 ;turn on fan\n";
-      g_state.printerSettings.wallSpeed = wallspeed;
-      g_state.printerSettings.infillSpeed = infillspeed;
+      m_wallSpeed = m_settings.wallSpeed;
+      m_infillSpeed = m_settings.infillSpeed;
     }
-    WriteSlice(slicer.getSlice(i));
+    WriteSlice(result.slices[i]);
   }
   WriteFooter();
   CloseGcodeFile();
@@ -38,10 +42,10 @@ GcodeWriter::GcodeWriter(const char *filepath, const Slicer &slicer) {
 void GcodeWriter::NewGcodeFile(const char *filename) { m_file.open(filename); }
 
 void GcodeWriter::WriteHeader() {
-  m_file << "M140 S" << g_state.printerSettings.bedTemp << "\n";
-  m_file << "M190 S" << g_state.printerSettings.bedTemp << "\n";
-  m_file << "M104 S" << g_state.printerSettings.nozzleTemp << "\n";
-  m_file << "M109 S" << g_state.printerSettings.nozzleTemp << "\n";
+  m_file << "M140 S" << m_settings.bedTemp << "\n";
+  m_file << "M190 S" << m_settings.bedTemp << "\n";
+  m_file << "M104 S" << m_settings.nozzleTemp << "\n";
+  m_file << "M109 S" << m_settings.nozzleTemp << "\n";
   m_file << "G21 ;set units to millimeters\n";
   m_file << "M82 ;set extruder to absolute mode\n";
   m_file << "G28 ;home all axes\n";
@@ -59,74 +63,79 @@ void GcodeWriter::WriteHeader() {
   m_file << "G1 F2700 E-5\n";
 }
 
-void GcodeWriter::WritePaths(const Clipper2Lib::PathsD &paths, float speed) {
-  for (auto &path : paths)
-    WritePath(path, speed);
+void GcodeWriter::WritePaths(const PathBuffer &paths, float speed) {
+  for (size_t i = 0; i < paths.getPathCount(); ++i)
+    WritePath(paths.getPath(i), speed);
 }
 
-void GcodeWriter::WritePath(const Clipper2Lib::PathD &path, float speed) {
+void GcodeWriter::WriteGroup(const PathBuffer &paths, size_t group,
+                             float speed) {
+  const auto [first, last] = paths.getGroupRange(group);
+  for (size_t i = first; i < last; ++i)
+    WritePath(paths.getPath(i), speed);
+}
+
+void GcodeWriter::WritePath(PathBuffer::PathView path, float speed) {
   if (path.empty())
     return;
 
-  if (distance(currentPosition, path[0]) >
-      g_state.sliceSettings.minimumRetractDistance) {
+  // Slice geometry is stored in microns, g-code is written in millimetres
+  Clipper2Lib::PointD start = toPointD(path[0]);
+  if (distance(currentPosition, start) > m_settings.minimumRetractDistance) {
     // Retract
-    m_file << "G1 F1800 E" << extrusion - g_state.sliceSettings.retractDistance
+    m_file << "G1 F1800 E" << extrusion - m_settings.retractDistance
            << " ; retract filament\n";
     // Move
-    m_file << "G0 F6000 X" << std::fixed << std::setprecision(3) << path[0].x
-           << " Y" << path[0].y << " Z" << layerHeight << "\n";
+    m_file << "G0 F6000 X" << std::fixed << std::setprecision(3) << start.x
+           << " Y" << start.y << " Z" << layerHeight << "\n";
     // Unretract
     m_file << "G1 F1800 E" << extrusion << " ; unretract filament\n";
   } else {
     // Move
-    m_file << "G0 F6000 X" << std::fixed << std::setprecision(3) << path[0].x
-           << " Y" << path[0].y << " Z" << layerHeight << "\n";
+    m_file << "G0 F6000 X" << std::fixed << std::setprecision(3) << start.x
+           << " Y" << start.y << " Z" << layerHeight << "\n";
   }
 
-  currentPosition = path[0];
+  currentPosition = start;
   for (size_t i = 1; i < path.size(); i++) {
-    float dist = distance(path[i - 1], path[i]);
-    currentPosition = path[i];
-    extrusion += g_state.sliceSettings.layerHeight *
-                 g_state.printerSettings.nozzleDiameter * dist / fa;
+    Clipper2Lib::PointD point = toPointD(path[i]);
+    float dist = distance(currentPosition, point);
+    currentPosition = point;
+    extrusion += m_layerThickness * m_nozzleDiameter * dist / fa;
     m_file << "G1 F" << std::fixed << std::setprecision(0) << speed
-           << std::setprecision(3) << " X" << path[i].x << " Y" << path[i].y
+           << std::setprecision(3) << " X" << point.x << " Y" << point.y
            << std::setprecision(5) << " E" << extrusion << "\n";
   }
 }
 
 void GcodeWriter::WriteSlice(const Slice &slice) {
 
-  if (slice.hasSupport()) {
+  if (slice.hasSupport() || slice.hasAdhesion()) {
     m_file << ";TYPE:SUPPORT\n";
-    for (auto &paths : slice.getSupport())
-      WritePaths(paths, g_state.printerSettings.wallSpeed * 60.0f);
+    WritePaths(slice.getSupport(), m_wallSpeed * 60.0f);
+    WritePaths(slice.getAdhesion(), m_wallSpeed * 60.0f);
   }
 
   if (slice.hasWalls()) {
     m_file << ";TYPE:WALL-INNER\n";
-    auto shells = slice.getShells();
-    for (auto it = shells.rbegin(); it != shells.rend(); ++it) {
-      WritePaths(*it, g_state.printerSettings.wallSpeed * 60.0f);
-    }
+    const auto &shells = slice.getShells();
+    for (size_t group = shells.getGroupCount(); group-- > 0;)
+      WriteGroup(shells, group, m_wallSpeed * 60.0f);
   }
 
   if (slice.hasPerimeter()) {
     m_file << ";TYPE:WALL-OUTER\n";
-    WritePaths(slice.getPerimeter(), g_state.printerSettings.wallSpeed * 60.0f);
+    WriteGroup(slice.getPaths(Slice::OuterWall), 0, m_wallSpeed * 60.0f);
   }
 
   if (slice.hasFill()) {
     m_file << ";TYPE:SKIN\n";
-    for (auto &skin : slice.getFill())
-      WritePaths(skin, g_state.printerSettings.infillSpeed * 60.0f);
+    WritePaths(slice.getFill(), m_infillSpeed * 60.0f);
   }
 
   if (slice.hasInfill()) {
     m_file << ";TYPE:FILL\n";
-    for (auto &infill : slice.getInfill())
-      WritePaths(infill, g_state.printerSettings.infillSpeed * 60.0f);
+    WritePaths(slice.getInfill(), m_infillSpeed * 60.0f);
   }
 }
 
@@ -0,0 +1,35 @@
+#include "layerFeed.h"
+
+void LayerFeed::publish(size_t index, size_t layerCount, Slice::PathType type,
+                        PathBuffer paths) {
+  Node *node = new Node{{index, layerCount, type, std::move(paths)},
+                        m_head.load(std::memory_order_relaxed)};
+  while (!m_head.compare_exchange_weak(node->next, node,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed))
+    ;
+}
+
+void LayerFeed::drain(const std::function<void(Layer &)> &consume) {
+  Node *node = m_head.exchange(nullptr, std::memory_order_acquire);
+
+  // The stack holds the newest layer first
+  Node *oldest = nullptr;
+  while (node) {
+    Node *next = node->next;
+    node->next = oldest;
+    oldest = node;
+    node = next;
+  }
+
+  while (oldest) {
+    Node *next = oldest->next;
+    consume(oldest->layer);
+    delete oldest;
+    oldest = next;
+  }
+}
+
+void LayerFeed::clear() {
+  drain([](Layer &) {});
+}
@@ -1,8 +1,11 @@
+#include "backgroundSlicer.h"
 #include "camera.h"
 #include "framebuffer.h"
 #include "gcodeWriter.h"
+#include "meshRenderer.h"
 #include "printer.h"
 #include "resources.h"
+#include "sliceRenderer.h"
 #include "slicer.h"
 #include "state.h"
 
@@ -12,12 +15,15 @@
 #include <clipper2/clipper.core.h>
 #include <clipper2/clipper.h>
 #include <clipper2/clipper.offset.h>
+#include <cfloat>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <glm/fwd.hpp>
 #include <glm/glm.hpp>
 #include <imgui.h>
 #include <memory>
+#include <optional>
 
 #define ZEROY glm::vec3(1.0f, 0.0f, 1.0f)
 
@@ -57,7 +63,27 @@ int main(int argc, char *argv[]) {
   Slicer slicer(g_state.fileSettings.inputFile);
   slicer.init(g_state.sliceSettings.layerHeight,
               g_state.printerSettings.nozzleDiameter);
+  slicer.setWorkerCount(g_state.sliceSettings.workerCount);
+  slicer.setCache(g_state.fileSettings.useCache
+                      ? StageCache::getDefaultDirectory()
+                      : std::filesystem::path(),
+                  uint64_t(g_state.fileSettings.cacheSizeMB) * 1024 * 1024);
   Model &model = slicer.getModel();
+  MeshRenderer modelRenderer(model);
+  SliceRenderer sliceRenderer;
+
+  // Slicing and exporting run on a background thread. The slicer and the
+  // model are left alone while it is busy, the views draw the last result.
+  BackgroundSlicer background(slicer);
+  std::shared_ptr<const SliceResult> result;
+  // Layers published by the running slice or the lazy preview, drawn
+  // instead of the result
+  std::vector<Slice> preview;
+  const std::vector<Slice> *shownSlices = nullptr;
+  // What the lazy preview last sliced
+  std::optional<PipelineSettings> previewSettings;
+  glm::mat4 previewTransform{1.0f};
+  int previewLayer = 0;
 
   model.setPosition(printer.getCenter() * ZEROY +
                     glm::vec3(0.0f, model.getHeight() / 2.0f, 0.0f));
@@ -134,8 +160,60 @@ int main(int argc, char *argv[]) {
   window->whileOpen([&]() {
     ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport());
 
+    bool busy = background.isBusy();
+    auto latest = background.getResult();
+    // Paths of finished layers replace the ones of the last result until the
+    // running slice publishes its own result. Lazily sliced layers stay until
+    // the settings change, and are only shown over the result when it was
+    // made with the same settings.
+    background.getFeed().drain([&](LayerFeed::Layer &layer) {
+      if (preview.empty() && result &&
+          result->slices.size() == layer.layerCount &&
+          (!previewSettings || *previewSettings == result->settings))
+        preview = result->slices;
+      preview.resize(layer.layerCount);
+      preview[layer.index].setPaths(layer.type, std::move(layer.paths));
+    });
+    const bool resultChanged = latest != result;
+    if ((!busy && !g_state.windowSettings.lazyPreview) || resultChanged)
+      preview.clear();
+
+    if (!g_state.windowSettings.lazyPreview) {
+      previewSettings.reset();
+    } else if (!busy) {
+      const auto settings = g_state.getJobSettings().pipeline;
+      const glm::mat4 transform = model.getModelMatrix();
+      const int layer = std::max(g_state.sliceSettings.sliceIndex - 1, 0);
+      const bool changed = !previewSettings || *previewSettings != settings ||
+                           transform != previewTransform;
+      if ((changed || layer != previewLayer) &&
+          background.startPreview(settings, layer)) {
+        if (changed)
+          preview.clear();
+        previewSettings = settings;
+        previewTransform = transform;
+        previewLayer = layer;
+        busy = true;
+      }
+    }
+
+    const size_t shownCount = shownSlices ? shownSlices->size() : 0;
+    result = std::move(latest);
+    shownSlices = !preview.empty() ? &preview
+                  : result         ? &result->slices
+                                   : nullptr;
+    if (resultChanged ||
+        (shownSlices ? shownSlices->size() : 0) != shownCount) {
+      g_state.sliceSettings.maxSliceIndex =
+          shownSlices ? static_cast<int>(shownSlices->size()) : 0;
+      g_state.sliceSettings.sliceIndex =
+          std::clamp(g_state.sliceSettings.sliceIndex, 1,
+                     std::max(g_state.sliceSettings.maxSliceIndex, 1));
+    }
+
     ImGui::Begin("Control Panel");
     {
+      ImGui::BeginDisabled(busy);
       if (ImGui::CollapsingHeader("Printer settings")) {
         if (ImGui::InputInt3("Printer Size (mm)", printer.getSizePtr()))
           model.setPosition(printer.getCenter() * ZEROY);
@@ -155,6 +233,7 @@ int main(int argc, char *argv[]) {
         if (ImGui::Button("Load")) {
           slicer.loadModel(g_state.fileSettings.inputFile);
           model = slicer.getModel();
+          modelRenderer.upload(model);
           model.setPosition(printer.getCenter() * ZEROY);
           model.getHeight();
           g_state.sliceSettings.maxSliceIndex =
@@ -164,6 +243,8 @@ int main(int argc, char *argv[]) {
                          g_state.sliceSettings.maxSliceIndex);
           g_state.data.slices.clear();
           g_state.data.supportAreas.clear();
+          background.clearResult();
+          previewSettings.reset();
         }
 
         ImGui::DragFloat3("Position", model.getPositionPtr(), 0,
@@ -173,6 +254,7 @@ int main(int argc, char *argv[]) {
 
         ImGui::Checkbox("Drop model down", &g_state.objectSettings.dropDown);
       }
+      ImGui::EndDisabled();
 
       if (ImGui::CollapsingHeader("Slice settings")) {
         if (ImGui::SliderInt("Slice Index", &g_state.sliceSettings.sliceIndex,
@@ -181,10 +263,21 @@ int main(int argc, char *argv[]) {
                                  g_state.sliceSettings.layerHeight);
         }
 
-        ImGui::InputInt("Extra shift", (int *)&slicer.extraShift);
+        ImGui::InputInt("Extra shift", &g_state.sliceSettings.extraShift);
+
+        ImGui::BeginDisabled(busy);
+        if (ImGui::InputInt("Worker threads",
+                            &g_state.sliceSettings.workerCount)) {
+          g_state.sliceSettings.workerCount =
+              std::clamp(g_state.sliceSettings.workerCount, 1, 256);
+          slicer.setWorkerCount(g_state.sliceSettings.workerCount);
+        }
+        ImGui::EndDisabled();
 
         ImGui::Checkbox("Show Slice Plane",
                         &g_state.windowSettings.showSlicePlane);
+        ImGui::Checkbox("Slice viewed layer only",
+                        &g_state.windowSettings.lazyPreview);
 
         if (ImGui::InputFloat("Layer Height",
                               &g_state.sliceSettings.layerHeight, 0.0f, 0.0f,
@@ -273,51 +366,33 @@ int main(int argc, char *argv[]) {
         }
       }
 
-      if (ImGui::Button("Slice", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
-        Logger::info("Creating slices");
-        slicer.createSlices();
-
-        Logger::info("Creating walls");
-        slicer.createWalls(g_state.sliceSettings.shellCount);
-
-        Logger::info("Creating fill");
-        slicer.createFill(g_state.sliceSettings.fillType,
-                          g_state.sliceSettings.floorCount,
-                          g_state.sliceSettings.roofCount);
-
-        if (g_state.sliceSettings.infillDensity > 0.0f) {
-          Logger::info("Creating infill");
-          slicer.createInfill(g_state.sliceSettings.infillType,
-                              g_state.sliceSettings.infillDensity / 100.0f);
-        }
-
-        if (g_state.sliceSettings.enableSupport) {
-          Logger::info("Creating support");
-          slicer.createSupport(g_state.sliceSettings.supportType,
-                               g_state.sliceSettings.infillDensity / 100.0f,
-                               g_state.sliceSettings.supportWallCount,
-                               g_state.sliceSettings.supportBrimCount);
-        }
-
-        switch (g_state.sliceSettings.adhesionType) {
-        case AdhesionTypes::Brim:
-          slicer.createBrim(g_state.sliceSettings.brimLocation,
-                            g_state.sliceSettings.brimLineCount);
-          break;
-        case Skirt:
-          slicer.createSkirt(g_state.sliceSettings.skirtLineCount,
-                             g_state.sliceSettings.skirtHeight,
-                             g_state.sliceSettings.skirtDistance);
-          break;
-        default:
-          break;
-        }
-        Logger::info("Slicing complete");
-      }
+      ImGui::BeginDisabled(busy);
+      if (ImGui::Button("Slice", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+        background.startSlice(g_state.getJobSettings().pipeline);
 
       if (ImGui::Button("Export to g-code",
-                        ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
-        GcodeWriter writer(g_state.fileSettings.outputFile, slicer);
+                        ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+        background.startExport(g_state.fileSettings.outputFile,
+                               g_state.getJobSettings());
+      ImGui::EndDisabled();
+
+      if (busy) {
+        const auto &progress = background.getProgress();
+        const size_t count = progress.getStepCount();
+        if (count > 0) {
+          const size_t done = std::min(progress.getStepsDone(), count);
+          char label[64];
+          std::snprintf(label, sizeof(label), "%s %zu/%zu",
+                        progress.getTaskName(), done, count);
+          ImGui::ProgressBar(static_cast<float>(done) / count,
+                             ImVec2(-FLT_MIN, 0), label);
+        } else {
+          // Tasks of unknown length only show their name
+          ImGui::Text("%s", progress.getTaskName());
+        }
+        if (ImGui::Button("Cancel",
+                          ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+          background.cancel();
       }
     }
     ImGui::End();
@@ -347,13 +422,13 @@ int main(int argc, char *argv[]) {
                          glm::vec3(0.7f, 0.7f, 0.7f),
                          glm::vec3(0.0f, 0.0f, 1.0f),
                          g_state.windowSettings.showSlicePlane);
-          if (g_state.objectSettings.dropDown) {
+          if (g_state.objectSettings.dropDown && !busy) {
             auto pos = model.getPosition();
             model.setPosition({pos.x, model.getHeight() / 2, pos.z});
           }
           previewShader.setBool("useShading", true);
-          model.render(previewShader, view, projection,
-                       glm::vec3(1.0f, 0.0f, 0.0f));
+          modelRenderer.render(model, previewShader, view, projection,
+                               glm::vec3(1.0f, 0.0f, 0.0f));
         }
         viewBuffer.unbind();
 
@@ -369,7 +444,7 @@ int main(int argc, char *argv[]) {
 
         sliceBuffer.bind();
         // if (!g_state.data.slices.empty()) {
-        if (slicer.hasSlices()) {
+        if (shownSlices && !shownSlices->empty()) {
           const int width = ImGui::GetContentRegionAvail().x;
           const int height = ImGui::GetContentRegionAvail().y;
 
@@ -389,8 +464,9 @@ int main(int argc, char *argv[]) {
           // g_state.data.slices[g_state.sliceSettings.sliceIndex - 1].render(
           //     sliceShader, position, g_state.windowSettings.sliceScale);
 
-          slicer.getSlice(g_state.sliceSettings.sliceIndex - 1)
-              .render(sliceShader, position, g_state.windowSettings.sliceScale);
+          sliceRenderer.render(
+              (*shownSlices)[g_state.sliceSettings.sliceIndex - 1],
+              sliceShader, position, g_state.windowSettings.sliceScale);
         }
         sliceBuffer.unbind();
 
@@ -0,0 +1,80 @@
+#include "meshRenderer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Welding shares corners between facets, averaging normals over them would
+// round off every hard edge. The mesh is drawn unindexed instead, each corner
+// with the normal of its own facet. Swapping y and z mirrors the mesh, so the
+// winding is reversed compared to the file.
+static void expandFacets(const std::vector<glm::vec3> &positions,
+                         const std::vector<uint32_t> &indices,
+                         std::vector<glm::vec3> &corners,
+                         std::vector<glm::vec3> &normals) {
+  corners.resize(indices.size() - indices.size() % 3);
+  normals.resize(corners.size());
+  for (size_t i = 0; i < corners.size(); i += 3) {
+    const glm::vec3 &v1 = positions[indices[i]];
+    const glm::vec3 &v2 = positions[indices[i + 1]];
+    const glm::vec3 &v3 = positions[indices[i + 2]];
+    glm::vec3 normal = glm::cross(v3 - v1, v2 - v1);
+    if (normal != glm::vec3(0.0f))
+      normal = glm::normalize(normal);
+
+    corners[i] = v1;
+    corners[i + 1] = v2;
+    corners[i + 2] = v3;
+    normals[i] = normals[i + 1] = normals[i + 2] = normal;
+  }
+}
+
+MeshRenderer::~MeshRenderer() {
+  if (m_VAO == 0)
+    return;
+  glDeleteVertexArrays(1, &m_VAO);
+  glDeleteBuffers(1, &m_VBO);
+  glDeleteBuffers(1, &m_normalVBO);
+}
+
+void MeshRenderer::upload(const Model &model) {
+  std::vector<glm::vec3> corners, normals;
+  expandFacets(model.getPositions(), model.getIndices(), corners, normals);
+
+  if (m_VAO == 0) {
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_normalVBO);
+  }
+
+  glBindVertexArray(m_VAO);
+
+  // Pos
+  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+  glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(glm::vec3),
+               corners.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  // Normal
+  glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
+  glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3),
+               normals.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+  m_vertexCount = static_cast<GLsizei>(corners.size());
+}
+
+void MeshRenderer::render(const Model &model, Shader &shader,
+                          const glm::mat4 &view, const glm::mat4 &projection,
+                          const glm::vec3 &color) const {
+  shader.use();
+  shader.setMVP(model.getModelMatrix(), view, projection);
+  shader.setVec3("color", color);
+
+  glBindVertexArray(m_VAO);
+  glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
+
+  glBindVertexArray(0);
+}
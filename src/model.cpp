@@ -1,30 +1,32 @@
 #include "model.h"
 #include "Nexus/Log.h"
 #include "glm/gtc/type_ptr.hpp"
+#include "hash.h"
+#include "mappedFile.h"
 #include "slice.h"
+#include "stlReader.h"
 #include "utils.h"
+#include "vertexWelder.h"
+#include "workspace.h"
 
 #include <Nexus.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <limits>
+#include <numeric>
+#include <sys/resource.h>
+#include <tuple>
+#include <unordered_map>
 
 #include <assimp/Importer.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/matrix_transform.hpp>
 
-// ======================= Triangle ========================
-Triangle::Triangle(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3)
-    : vertices({v1, v2, v3}) {}
-float Triangle::getYmin() const {
-  return std::min({vertices[0].y, vertices[1].y, vertices[2].y});
-}
-float Triangle::getYmax() const {
-  return std::max({vertices[0].y, vertices[1].y, vertices[2].y});
-}
-glm::vec3 Triangle::operator[](int i) const { return vertices[i]; }
-
 // ========================= Model =========================
 std::string readFile(const char *filePath) {
   std::string content;
@@ -46,68 +48,75 @@ std::string readFile(const char *filePath) {
   return content;
 }
 
-Model::Model(const char *path) : m_scale(1.0f) {
-  using namespace Nexus;
-
-  Assimp::Importer import;
-  const aiScene *scene =
-      import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-    Logger::error("ASSIMP::{}", import.GetErrorString());
-
-  if (scene->mRootNode->mNumMeshes > 1)
-    Logger::error("Only one mesh per model is supported, {} provided. Only the "
-                  "first mesh will be loaded",
-                  scene->mRootNode->mNumMeshes);
-  if (scene->mRootNode->mNumChildren > 1)
-    Logger::error("Nested meshes is not supported");
-
-  const auto mesh = scene->mMeshes[scene->mRootNode->mChildren[0]->mMeshes[0]];
-
-  processVertices(mesh);
-  processIndices(mesh);
-  processTriangles();
+// Peak resident set size of the process in megabytes
+static double getPeakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
 
-  initOpenGLBuffers();
+static void logLoadTime(const char *source, size_t triangleCount,
+                        std::chrono::steady_clock::time_point start) {
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  Nexus::Logger::info("Loaded {} triangles from {} in {} ms, peak RSS {} MB",
+                      triangleCount, source, elapsed.count() * 1000.0,
+                      getPeakRss());
 }
 
-Model::Model(const char *data, size_t length) : m_scale(1.0f) {
+Model::Model(const char *path, ThreadPool &threadPool) : m_scale(1.0f) {
   using namespace Nexus;
+  const auto start = std::chrono::steady_clock::now();
+
+  // A binary file whose size does not match its facet count but whose header
+  // starts with "solid" passes isStl as ASCII and then fails to parse. Assimp
+  // gets a second try at anything the STL reader rejects.
+  MappedFile file(path);
+  bool loaded = false;
+  if (file.isOpen() && isStl(file.data(), file.size())) {
+    loaded = processStl(file.data(), file.size(), threadPool);
+    if (!loaded)
+      Logger::warn("Could not read {} as STL, trying Assimp", path);
+  }
+  if (!loaded) {
+    Assimp::Importer import;
+    const aiScene *scene =
+        import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    if (!processScene(scene))
+      Logger::error("ASSIMP::{}", import.GetErrorString());
+  }
 
-  Assimp::Importer import;
-  const aiScene *scene = import.ReadFileFromMemory(
-      data, length, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-    Logger::error("ASSIMP::{}", import.GetErrorString());
-
-  if (scene->mRootNode->mNumMeshes > 1)
-    Logger::error("Only one mesh per model is supported, {} provided. Only the "
-                  "first mesh will be loaded",
-                  scene->mRootNode->mNumMeshes);
-  if (scene->mRootNode->mNumChildren > 1)
-    Logger::error("Nested meshes is not supported");
-
-  const auto mesh = scene->mMeshes[scene->mRootNode->mChildren[0]->mMeshes[0]];
-
-  processVertices(mesh);
-  processIndices(mesh);
-  processTriangles();
-
-  initOpenGLBuffers();
+  processWelding(threadPool);
+  processAdjacency();
+  logLoadTime(path, getTriangleCount(), start);
 }
 
-void Model::render(Shader &shader, const glm::mat4 &view,
-                   const glm::mat4 &projection, const glm::vec3 &color) {
-  shader.use();
-  shader.setMVP(getModelMatrix(), view, projection);
-  shader.setVec3("color", color);
-
-  glBindVertexArray(m_VAO);
-  glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+Model::Model(const char *data, size_t length) : m_scale(1.0f) {
+  using namespace Nexus;
+  const auto start = std::chrono::steady_clock::now();
+
+  ThreadPool serial(1);
+  bool loaded = false;
+  if (isStl(data, length)) {
+    loaded = processStl(data, length, serial);
+    if (!loaded)
+      Logger::warn("Could not read data as STL, trying Assimp");
+  }
+  if (!loaded) {
+    Assimp::Importer import;
+    const aiScene *scene = import.ReadFileFromMemory(
+        data, length, aiProcess_Triangulate | aiProcess_FlipUVs);
+    if (!processScene(scene))
+      Logger::error("ASSIMP::{}", import.GetErrorString());
+  }
 
-  glBindVertexArray(0);
+  processWelding(serial);
+  processAdjacency();
+  logLoadTime("memory", getTriangleCount(), start);
 }
 
 glm::vec3 Model::getMin() const { return m_min * m_scale; }
@@ -115,23 +124,35 @@ glm::vec3 Model::getMax() const { return m_max * m_scale; }
 glm::vec3 Model::getCenter() const { return m_center * m_scale; }
 
 float Model::getHeight() {
-  auto model = getModelMatrix();
-  m_max = glm::vec3(-std::numeric_limits<float>::max());
-  m_min = glm::vec3(std::numeric_limits<float>::max());
-
-  for (auto &vertex : m_vertices) {
-    auto transformed = model * glm::vec4(vertex.position, 1.0f);
-    m_max = glm::max(m_max, glm::vec3(transformed));
-    m_min = glm::min(m_min, glm::vec3(transformed));
-  }
+  getWorldPositions();
+  m_max = m_worldMax;
+  m_min = m_worldMin;
 
   return m_max.y - m_min.y;
 }
 
+std::pair<glm::vec3, glm::vec3> Model::getWorldBounds() {
+  getWorldPositions();
+  return {m_worldMin, m_worldMax};
+}
+
 size_t Model::getLayerCount(float layerheight) const {
   return (getMax().y - getMin().y) / layerheight;
 }
 
+uint64_t Model::getContentHash() {
+  if (!m_hasContentHash) {
+    Fnv1a hash;
+    hash.add(m_positions.size());
+    hash.addWords(m_positions.data(), m_positions.size() * sizeof(glm::vec3));
+    hash.add(m_indices.size());
+    hash.addWords(m_indices.data(), m_indices.size() * sizeof(uint32_t));
+    m_contentHash = hash.get();
+    m_hasContentHash = true;
+  }
+  return m_contentHash;
+}
+
 void Model::setPosition(glm::vec3 position) { m_position = position; }
 glm::vec3 Model::getPosition() const { return m_position; }
 float *Model::getPositionPtr() { return glm::value_ptr(m_position); }
@@ -144,59 +165,249 @@ void Model::setScale(glm::vec3 scale) { m_scale = scale; }
 const glm::vec3 &Model::getScale() const { return m_scale; }
 float *Model::getScalePtr() { return glm::value_ptr(m_scale); }
 
-Slice Model::getSlice(double sliceHeight) {
+Slice Model::getSlice(double sliceHeight, StageCounters *counters) {
+  LayerScope scope(counters, Stage::Slices);
   sliceHeight += 0.000000001;
+  const auto &positions = getWorldPositions();
+
+  // Only the triangles spanning the plane are gathered, in mesh order
+  TriangleStore triangles;
+  for (size_t i = 0; i + 2 < m_indices.size(); i += 3) {
+    const glm::vec3 &v1 = positions[m_indices[i]];
+    const glm::vec3 &v2 = positions[m_indices[i + 1]];
+    const glm::vec3 &v3 = positions[m_indices[i + 2]];
+    if (std::min({v1.y, v2.y, v3.y}) < sliceHeight &&
+        std::max({v1.y, v2.y, v3.y}) > sliceHeight)
+      triangles.push_back(v1, v2, v3);
+  }
+
   std::vector<Line> lineSegments;
-  for (const auto &triangleOrig : m_triangles) {
-    auto triangle = transformTriangle(triangleOrig);
-    if (triangle.getYmin() >= sliceHeight || triangle.getYmax() <= sliceHeight)
+  intersectTriangles(triangles, sliceHeight, lineSegments);
+
+  return {lineSegments};
+}
+
+static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+// Point where the plane crosses edge `edge` of `triangle`. The edge is always
+// interpolated from the same end, so both triangles sharing it agree exactly.
+static Clipper2Lib::PointD edgeIntersection(const TriangleStore &triangles,
+                                            uint32_t triangle, int edge,
+                                            double sliceHeight) {
+  auto v1 = triangles.corner(triangle, edge);
+  auto v2 = triangles.corner(triangle, (edge + 1) % 3);
+  if (std::tie(v2.y, v2.x, v2.z) < std::tie(v1.y, v1.x, v1.z))
+    std::swap(v1, v2);
+
+  double t = (sliceHeight - v1.y) / (v2.y - v1.y);
+  return {v1.x + t * (v2.x - v1.x), v1.z + t * (v2.z - v1.z)};
+}
+
+// Traces the closed contours of a layer by walking from triangle to triangle
+// across the edges the plane crosses. `crossing` holds the sorted indices of
+// all triangles spanning the plane. Returns false when a contour runs into an
+// edge without a neighbour, in which case the caller has to stitch instead.
+static bool traceContours(const TriangleStore &triangles,
+                          const std::vector<std::array<uint32_t, 3>> &adjacency,
+                          const std::vector<uint32_t> &crossing,
+                          double sliceHeight, Clipper2Lib::PathsD &contours) {
+  auto crossedEdges = [&](uint32_t triangle) -> std::pair<int, int> {
+    std::array<int, 2> edges;
+    int count = 0;
+    for (int i = 0; i < 3 && count < 2; ++i) {
+      const bool below = triangles.y[i][triangle] < sliceHeight;
+      const bool nextBelow = triangles.y[(i + 1) % 3][triangle] < sliceHeight;
+      if (below != nextBelow)
+        edges[count++] = i;
+    }
+    return {edges[0], edges[1]};
+  };
+
+  std::vector<bool> visited(crossing.size(), false);
+  auto visit = [&](uint32_t triangle) -> bool {
+    auto it = std::lower_bound(crossing.begin(), crossing.end(), triangle);
+    if (it == crossing.end() || *it != triangle)
+      return false;
+    visited[it - crossing.begin()] = true;
+    return true;
+  };
+
+  for (size_t start = 0; start < crossing.size(); ++start) {
+    if (visited[start])
       continue;
+    visited[start] = true;
 
-    Line segment;
+    // Degenerate triangles are left out of the adjacency
+    const uint32_t first = crossing[start];
+    if (adjacency[first][0] == NO_NEIGHBOUR)
+      continue;
 
-    for (int i = 0; i < 3; ++i) {
-      const auto &v1 = triangle[i];
-      const auto &v2 = triangle[(i + 1) % 3];
-      if ((v1.y - sliceHeight) * (v2.y - sliceHeight) > 0)
-        continue;
+    auto [entryEdge, exitEdge] = crossedEdges(first);
+    Clipper2Lib::PathD contour{
+        edgeIntersection(triangles, first, entryEdge, sliceHeight)};
+    uint32_t current = first;
+    while (true) {
+      contour.push_back(
+          edgeIntersection(triangles, current, exitEdge, sliceHeight));
+
+      const uint32_t link = adjacency[current][exitEdge];
+      if (link == NO_NEIGHBOUR)
+        return false;
+
+      current = link / 3;
+      if (current == first)
+        break;
+      if (!visit(current))
+        return false;
+
+      auto [a, b] = crossedEdges(current);
+      exitEdge = a == static_cast<int>(link % 3) ? b : a;
+    }
+    contours.push_back(std::move(contour));
+  }
+  return true;
+}
 
-      double t = (sliceHeight - v1.y) / (v2.y - v1.y);
-      double x = v1.x + t * (v2.x - v1.x);
-      double z = v1.z + t * (v2.z - v1.z);
-      segment.setNextPoint({x, z});
+// Time spent in the intersection kernel and the number of triangles it tested
+struct KernelStats {
+  size_t tested = 0;
+  double seconds = 0.0;
+};
+
+// Sweeps the plane upwards over the layers [begin, end). `order` holds the
+// triangle indices sorted by their lowest point. A triangle enters the active
+// set once the plane passes its bottom and leaves it for good once the plane
+// reaches its top.
+// When `adjacency` is given the contours are traced along the mesh topology,
+// otherwise the intersected segments are stitched together.
+static KernelStats
+sweepSlices(const TriangleStore &triangles,
+            const std::vector<std::array<uint32_t, 3>> *adjacency,
+            const std::vector<uint32_t> &order,
+            const std::vector<double> &sliceHeights, size_t begin, size_t end,
+            std::vector<Slice> &slices, JobProgress *progress,
+            StageCounters *counters) {
+  std::vector<uint32_t> active;
+  // Reused by every layer, the Slice constructor leaves it empty
+  std::vector<Line> lineSegments;
+  size_t next = 0;
+  KernelStats stats;
+  for (size_t layer = begin; layer < end; ++layer) {
+    if (progress && !progress->step())
+      break;
+    LayerScope scope(counters, Stage::Slices);
+    double sliceHeight = sliceHeights[layer] + 0.000000001;
+
+    while (next < order.size() &&
+           triangles.yMin[order[next]] < sliceHeight)
+      active.push_back(order[next++]);
+    std::erase_if(active, [&](uint32_t i) {
+      return triangles.yMax[i] <= sliceHeight;
+    });
+    // Keep the segments in mesh order so stitching matches getSlice
+    std::sort(active.begin(), active.end());
+
+    Clipper2Lib::PathsD contours;
+    if (adjacency &&
+        traceContours(triangles, *adjacency, active, sliceHeight, contours)) {
+      slices[layer] = Slice(contours);
+      continue;
     }
-    if (distance(segment.p1, segment.p2) >= 1e-3)
-      lineSegments.push_back(segment);
+
+    const auto kernelStart = std::chrono::steady_clock::now();
+    intersectTriangles(triangles, active.data(), active.size(), sliceHeight,
+                       lineSegments);
+    const std::chrono::duration<double> kernelTime =
+        std::chrono::steady_clock::now() - kernelStart;
+    stats.tested += active.size();
+    stats.seconds += kernelTime.count();
+
+    slices[layer] = Slice(lineSegments);
   }
+  return stats;
+}
 
-  return {lineSegments};
+std::vector<Slice> Model::getSlices(const std::vector<double> &sliceHeights,
+                                    ThreadPool &threadPool,
+                                    JobProgress *progress,
+                                    StageCounters *counters) {
+  const auto start = std::chrono::steady_clock::now();
+  // Only kept while slicing, the model holds on to the shared positions
+  const TriangleStore triangles = getWorldTriangles();
+
+  std::vector<uint32_t> order(triangles.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return triangles.yMin[a] < triangles.yMin[b];
+  });
+
+  std::vector<Slice> slices(sliceHeights.size());
+  const size_t chunkCount =
+      std::min(threadPool.getWorkerCount(), sliceHeights.size());
+  std::vector<KernelStats> stats(chunkCount);
+  threadPool.parallelFor(chunkCount, [&](size_t chunk) {
+    stats[chunk] = sweepSlices(
+        triangles, m_isManifold ? &m_adjacency : nullptr, order, sliceHeights,
+        sliceHeights.size() * chunk / chunkCount,
+        sliceHeights.size() * (chunk + 1) / chunkCount, slices, progress,
+        counters);
+  });
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  Nexus::Logger::debug("Sliced {} triangles into {} layers in {} ms",
+                       triangles.size(), slices.size(),
+                       elapsed.count() * 1000.0);
+
+  // Summed over the chunks, so this is the rate of a single thread
+  KernelStats kernel;
+  for (const KernelStats &chunk : stats) {
+    kernel.tested += chunk.tested;
+    kernel.seconds += chunk.seconds;
+  }
+  if (kernel.seconds > 0.0)
+    Nexus::Logger::debug(
+        "Intersection kernel tested {} triangles in {} ms ({} triangles/s)",
+        kernel.tested, kernel.seconds * 1000.0,
+        static_cast<size_t>(kernel.tested / kernel.seconds));
+
+  return slices;
 }
 
-void Model::initOpenGLBuffers() {
-  glGenVertexArrays(1, &m_VAO);
-  glGenBuffers(1, &m_VBO);
-  glGenBuffers(1, &m_EBO);
+bool Model::processStl(const char *data, size_t length,
+                       ThreadPool &threadPool) {
+  StlMesh mesh;
+  if (!readStl(data, length, threadPool, mesh))
+    return false;
 
-  glBindVertexArray(m_VAO);
+  m_positions = std::move(mesh.positions);
+  m_indices.resize(m_positions.size());
+  std::iota(m_indices.begin(), m_indices.end(), 0);
 
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex),
-               m_vertices.data(), GL_STATIC_DRAW);
+  m_min = mesh.min;
+  m_max = mesh.max;
+  m_center = (m_max + m_min) / 2.0f;
+  return true;
+}
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint),
-               m_indices.data(), GL_STATIC_DRAW);
+bool Model::processScene(const aiScene *scene) {
+  using namespace Nexus;
 
-  // Pos
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, position));
-  glEnableVertexAttribArray(0);
-  // Normal
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, normal));
-  glEnableVertexAttribArray(1);
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    return false;
 
-  glBindVertexArray(0);
+  if (scene->mRootNode->mNumMeshes > 1)
+    Logger::error("Only one mesh per model is supported, {} provided. Only the "
+                  "first mesh will be loaded",
+                  scene->mRootNode->mNumMeshes);
+  if (scene->mRootNode->mNumChildren > 1)
+    Logger::error("Nested meshes is not supported");
+
+  const auto mesh = scene->mMeshes[scene->mRootNode->mChildren[0]->mMeshes[0]];
+
+  processVertices(mesh);
+  processIndices(mesh);
+  return true;
 }
 
 void Model::processVertices(const aiMesh *mesh) {
@@ -209,21 +420,14 @@ void Model::processVertices(const aiMesh *mesh) {
     vector.y = mesh->mVertices[i].z;
     vector.z = mesh->mVertices[i].y;
 
-    glm::vec3 normal;
-    if (mesh->mNormals) {
-      normal.x = mesh->mNormals[i].x;
-      normal.y = mesh->mNormals[i].z;
-      normal.z = mesh->mNormals[i].y;
-    }
-
     m_max = glm::max(m_max, vector);
     m_min = glm::min(m_min, vector);
-    m_vertices.push_back(Vertex(vector, normal));
+    m_positions.push_back(vector);
   }
 
   m_center = (m_max + m_min) / 2.0f;
-  for (auto &vertex : m_vertices)
-    vertex.position -= m_center;
+  for (auto &position : m_positions)
+    position -= m_center;
 }
 
 void Model::processIndices(const aiMesh *mesh) {
@@ -235,12 +439,66 @@ void Model::processIndices(const aiMesh *mesh) {
   }
 }
 
-void Model::processTriangles() {
-  for (size_t i = 0; i < m_indices.size(); i += 3) {
-    m_triangles.emplace_back(m_vertices[m_indices[i]].position,
-                             m_vertices[m_indices[i + 1]].position,
-                             m_vertices[m_indices[i + 2]].position);
+// Corners this close are merged (see weldVertices). Corners of one cell can
+// be up to sqrt(3) times as far apart, which is still far below the micron
+// resolution slices are stored in, so welding never changes a contour.
+static constexpr float WELD_TOLERANCE = 1e-4f;
+
+void Model::processWelding(ThreadPool &threadPool) {
+  std::vector<uint32_t> ids;
+  std::vector<uint32_t> firstVertex;
+  weldVertices(m_positions, WELD_TOLERANCE, threadPool, ids, firstVertex);
+
+  std::vector<glm::vec3> positions(firstVertex.size());
+  for (size_t i = 0; i < firstVertex.size(); ++i)
+    positions[i] = m_positions[firstVertex[i]];
+  for (auto &index : m_indices)
+    index = ids[index];
+
+  Nexus::Logger::debug("Welded {} vertices into {}", m_positions.size(),
+                       positions.size());
+  m_positions = std::move(positions);
+}
+
+void Model::processAdjacency() {
+  struct EdgeUse {
+    uint32_t first;
+    uint32_t count;
+  };
+  std::unordered_map<uint64_t, EdgeUse> edges;
+  const size_t triangleCount = getTriangleCount();
+  edges.reserve(triangleCount * 3 / 2);
+  m_adjacency.assign(triangleCount, {NO_NEIGHBOUR, NO_NEIGHBOUR, NO_NEIGHBOUR});
+  m_isManifold = true;
+
+  for (uint32_t i = 0; i < triangleCount; ++i) {
+    // Welding gave coincident corners the same index
+    const uint32_t *c = &m_indices[i * 3];
+    if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0])
+      continue;
+
+    for (uint32_t j = 0; j < 3; ++j) {
+      const uint32_t a = std::min(c[j], c[(j + 1) % 3]);
+      const uint32_t b = std::max(c[j], c[(j + 1) % 3]);
+      auto [it, inserted] = edges.try_emplace(
+          (static_cast<uint64_t>(a) << 32) | b, EdgeUse{i * 3 + j, 0});
+      auto &use = it->second;
+      if (++use.count == 2) {
+        m_adjacency[i][j] = use.first;
+        m_adjacency[use.first / 3][use.first % 3] = i * 3 + j;
+      } else if (use.count > 2) {
+        m_isManifold = false;
+      }
+    }
   }
+
+  for (const auto &[key, use] : edges)
+    if (use.count != 2)
+      m_isManifold = false;
+
+  if (!m_isManifold)
+    Nexus::Logger::warn("Mesh has open or non-manifold edges, slice contours "
+                        "will be stitched from segments");
 }
 
 glm::mat4 Model::getModelMatrix() const {
@@ -256,10 +514,38 @@ glm::mat4 Model::getModelMatrix() const {
   return model;
 }
 
-Triangle Model::transformTriangle(const Triangle &triangle) const {
-  glm::mat4 transformation = getModelMatrix();
-  Triangle result(transformation * glm::vec4(triangle.vertices[0], 1.0f),
-                  transformation * glm::vec4(triangle.vertices[1], 1.0f),
-                  transformation * glm::vec4(triangle.vertices[2], 1.0f));
-  return result;
+const std::vector<glm::vec3> &Model::getWorldPositions() {
+  // The transform can also be edited through the raw pointers handed to the
+  // UI, so compare against the transform the positions were built with.
+  if (m_worldValid && m_worldPosition == m_position &&
+      m_worldRotation == m_rotation && m_worldScale == m_scale)
+    return m_worldPositions;
+
+  const glm::mat4 transformation = getModelMatrix();
+  m_worldPositions.resize(m_positions.size());
+  for (size_t i = 0; i < m_positions.size(); ++i)
+    m_worldPositions[i] = transformation * glm::vec4(m_positions[i], 1.0f);
+
+  m_worldMax = glm::vec3(-std::numeric_limits<float>::max());
+  m_worldMin = glm::vec3(std::numeric_limits<float>::max());
+  for (uint32_t index : m_indices) {
+    m_worldMax = glm::max(m_worldMax, m_worldPositions[index]);
+    m_worldMin = glm::min(m_worldMin, m_worldPositions[index]);
+  }
+
+  m_worldPosition = m_position;
+  m_worldRotation = m_rotation;
+  m_worldScale = m_scale;
+  m_worldValid = true;
+  return m_worldPositions;
+}
+
+TriangleStore Model::getWorldTriangles() {
+  const auto &positions = getWorldPositions();
+  TriangleStore triangles;
+  triangles.reserve(getTriangleCount());
+  for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+    triangles.push_back(positions[m_indices[i]], positions[m_indices[i + 1]],
+                        positions[m_indices[i + 2]]);
+  return triangles;
 }
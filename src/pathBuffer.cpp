@@ -0,0 +1,28 @@
+#include "pathBuffer.h"
+
+using namespace Clipper2Lib;
+
+void PathBuffer::append(const Paths64 &paths) {
+  for (const auto &path : paths) {
+    m_points.insert(m_points.end(), path.begin(), path.end());
+    m_pathEnds.push_back(static_cast<uint32_t>(m_points.size()));
+  }
+  m_groupEnds.push_back(static_cast<uint32_t>(m_pathEnds.size()));
+}
+
+void PathBuffer::clear() {
+  m_points.clear();
+  m_pathEnds.clear();
+  m_groupEnds.clear();
+}
+
+Paths64 PathBuffer::getGroup(size_t group) const {
+  const auto [first, last] = getGroupRange(group);
+  Paths64 paths;
+  paths.reserve(last - first);
+  for (size_t i = first; i < last; ++i) {
+    const PathView path = getPath(i);
+    paths.emplace_back(path.begin(), path.end());
+  }
+  return paths;
+}
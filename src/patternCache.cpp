@@ -0,0 +1,95 @@
+#include "patternCache.h"
+#include "slicer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Clipper2Lib;
+
+// Range of the rotated y coordinates of the corners of `bounds`
+static std::pair<int64_t, int64_t> getRotatedSpan(const Rect64 &bounds,
+                                                  double angle) {
+  Paths64 corners{bounds.AsPath()};
+  rotatePaths(corners, angle);
+  const Rect64 rotated = GetBounds(corners);
+  return {rotated.top, rotated.bottom};
+}
+
+static int64_t getRotatedY(const Point64 &point, double angle) {
+  Paths64 points{{point}};
+  rotatePaths(points, angle);
+  return points.front().front().y;
+}
+
+static std::shared_ptr<const LinePattern>
+createLinePattern(const Rect64 &bounds, const Point64 &anchor, double angle,
+                  int64_t spacing, int64_t phase) {
+  auto pattern = std::make_shared<LinePattern>();
+  pattern->angle = angle;
+  pattern->spacing = spacing;
+
+  Paths64 corners{bounds.AsPath()};
+  rotatePaths(corners, angle);
+  const auto [minX, minY, maxX, maxY] = GetBounds(corners.front());
+
+  // Start at the last line at or below the bottom of the rotated bounds
+  const int64_t origin = getRotatedY(anchor, angle) + phase;
+  const int64_t first =
+      origin + static_cast<int64_t>(std::floor(
+                   static_cast<double>(minY - origin) / spacing)) *
+                   spacing;
+  pattern->firstOffset = first;
+
+  for (int64_t y = first; y <= maxY; y += spacing)
+    pattern->lines.push_back({{minX, y}, {maxX, y}});
+  unRotatePaths(pattern->lines, angle);
+  return pattern;
+}
+
+std::pair<size_t, size_t>
+LinePattern::getRange(const Rect64 &bounds) const {
+  // Widened by one unit for the rounding of the rotation
+  const auto [minY, maxY] = getRotatedSpan(bounds, angle);
+  const double first =
+      std::ceil(static_cast<double>(minY - 1 - firstOffset) / spacing);
+  const double last =
+      std::floor(static_cast<double>(maxY + 1 - firstOffset) / spacing) + 1;
+
+  const double count = static_cast<double>(lines.size());
+  return {static_cast<size_t>(std::clamp(first, 0.0, count)),
+          static_cast<size_t>(std::clamp(last, 0.0, count))};
+}
+
+void PatternCache::reset(const Rect64 &bounds) {
+  std::lock_guard lock(m_mutex);
+  m_bounds = bounds;
+  m_anchor = bounds.MidPoint();
+  m_patterns.clear();
+}
+
+int64_t PatternCache::getOffset(double angle, int64_t phase) {
+  std::unique_lock lock(m_mutex);
+  const Point64 anchor = m_anchor;
+  lock.unlock();
+  return getRotatedY(anchor, angle) + phase;
+}
+
+std::shared_ptr<const LinePattern>
+PatternCache::getLines(const Rect64 &areaBounds, double angle, int64_t spacing,
+                       int64_t phase) {
+  phase = (phase % spacing + spacing) % spacing;
+
+  std::unique_lock lock(m_mutex);
+  if (areaBounds.left < m_bounds.left || areaBounds.top < m_bounds.top ||
+      areaBounds.right > m_bounds.right ||
+      areaBounds.bottom > m_bounds.bottom) {
+    const Point64 anchor = m_anchor;
+    lock.unlock();
+    return createLinePattern(areaBounds, anchor, angle, spacing, phase);
+  }
+
+  auto &pattern = m_patterns[{angle, spacing, phase}];
+  if (!pattern)
+    pattern = createLinePattern(m_bounds, m_anchor, angle, spacing, phase);
+  return pattern;
+}
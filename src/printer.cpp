@@ -7,6 +7,7 @@
 
 Printer::Printer(glm::ivec3 size, float nozzle)
     : m_base(planeOBJ, planeOBJSize), m_slicePlane(planeOBJ, planeOBJSize),
+      m_baseRenderer(m_base), m_slicePlaneRenderer(m_slicePlane),
       m_size(size), m_nozzle(nozzle) {
   setSize(size);
   m_slicePlane.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
@@ -35,7 +36,8 @@ void Printer::setSliceHeight(float sliceHeight) {
 void Printer::render(Shader &shader, const glm::mat4 &view,
                      const glm::mat4 &projection, const glm::vec3 &colorBase,
                      const glm::vec3 &colorSlice, bool showSlicePlane) {
-  m_base.render(shader, view, projection, colorBase);
+  m_baseRenderer.render(m_base, shader, view, projection, colorBase);
   if (showSlicePlane)
-    m_slicePlane.render(shader, view, projection, colorSlice);
+    m_slicePlaneRenderer.render(m_slicePlane, shader, view, projection,
+                                colorSlice);
 }
\ No newline at end of file
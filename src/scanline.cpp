@@ -0,0 +1,162 @@
+#include "scanline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/trigonometric.hpp>
+#include <limits>
+#include <vector>
+
+using namespace Clipper2Lib;
+
+namespace {
+
+struct Edge {
+  double x0, y0;
+  double slope; // dx / dy
+  int64_t firstLine, lastLine;
+  int winding;
+};
+
+struct Crossing {
+  double x;
+  int winding;
+};
+
+// Reused by every call on a thread, so clipping a layer does not allocate
+// once the buffers have grown to the largest area seen
+struct Scratch {
+  std::vector<PointD> points;
+  std::vector<Edge> edges;
+  std::vector<size_t> lineStart;
+  std::vector<Crossing> crossings;
+};
+
+bool isInside(int winding, FillRule fillRule) {
+  switch (fillRule) {
+  case FillRule::EvenOdd:
+    return winding % 2 != 0;
+  case FillRule::Positive:
+    return winding > 0;
+  case FillRule::Negative:
+    return winding < 0;
+  default:
+    return winding != 0;
+  }
+}
+
+} // namespace
+
+void clipLines(Paths64 &result, const Paths64 &area, FillRule fillRule,
+               double angle, int64_t firstOffset, int64_t spacing) {
+  if (spacing <= 0 || area.empty())
+    return;
+
+  // Same rotation as rotatePaths, so the lines match the pattern cache
+  const float radians = glm::radians(static_cast<float>(angle));
+  const double cos = std::cos(radians);
+  const double sin = std::sin(radians);
+
+  thread_local Scratch scratch;
+  auto &[points, edges, lineStart, crossings] = scratch;
+  edges.clear();
+
+  // A line crosses an edge if it lies in [min y, max y) of the edge, so a
+  // line through a vertex is counted once for the two edges meeting there.
+  const double step = static_cast<double>(spacing);
+  auto lineAtOrAbove = [&](double y) {
+    return static_cast<int64_t>(std::ceil((y - firstOffset) / step));
+  };
+
+  int64_t minLine = std::numeric_limits<int64_t>::max();
+  int64_t maxLine = std::numeric_limits<int64_t>::min();
+  for (const auto &path : area) {
+    if (path.size() < 3)
+      continue;
+
+    points.clear();
+    for (const auto &point : path) {
+      const double x = static_cast<double>(point.x);
+      const double y = static_cast<double>(point.y);
+      points.push_back({x * cos - y * sin, x * sin + y * cos});
+    }
+
+    for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+      const PointD &from = points[j];
+      const PointD &to = points[i];
+      if (from.y == to.y)
+        continue;
+
+      const bool up = to.y > from.y;
+      const PointD &low = up ? from : to;
+      const PointD &high = up ? to : from;
+      const int64_t firstLine = lineAtOrAbove(low.y);
+      const int64_t lastLine = lineAtOrAbove(high.y);
+      if (firstLine == lastLine)
+        continue;
+
+      edges.push_back({low.x, low.y, (high.x - low.x) / (high.y - low.y),
+                       firstLine, lastLine, up ? 1 : -1});
+      minLine = std::min(minLine, firstLine);
+      maxLine = std::max(maxLine, lastLine);
+    }
+  }
+  if (edges.empty())
+    return;
+
+  // Bucket the crossings by line: count, prefix sum, then fill
+  const size_t lineCount = static_cast<size_t>(maxLine - minLine);
+  lineStart.assign(lineCount + 1, 0);
+  for (const auto &edge : edges)
+    for (int64_t k = edge.firstLine; k < edge.lastLine; ++k)
+      ++lineStart[k - minLine + 1];
+  for (size_t k = 0; k < lineCount; ++k)
+    lineStart[k + 1] += lineStart[k];
+
+  crossings.resize(lineStart.back());
+  for (const auto &edge : edges) {
+    for (int64_t k = edge.firstLine; k < edge.lastLine; ++k) {
+      const double y = static_cast<double>(firstOffset + k * spacing);
+      // lineStart[k] is used as the insertion cursor and restored below
+      crossings[lineStart[k - minLine]++] = {
+          edge.x0 + (y - edge.y0) * edge.slope, edge.winding};
+    }
+  }
+  for (size_t k = lineCount; k > 0; --k)
+    lineStart[k] = lineStart[k - 1];
+  lineStart[0] = 0;
+
+  auto unrotate = [&](double x, double y) -> Point64 {
+    return {std::llrint(x * cos + y * sin), std::llrint(y * cos - x * sin)};
+  };
+
+  for (size_t k = 0; k < lineCount; ++k) {
+    const auto begin = crossings.begin() + lineStart[k];
+    const auto end = crossings.begin() + lineStart[k + 1];
+    std::sort(begin, end, [](const Crossing &a, const Crossing &b) {
+      return a.x < b.x;
+    });
+
+    const double y =
+        static_cast<double>(firstOffset + (minLine + int64_t(k)) * spacing);
+    int winding = 0;
+    double spanStart = 0.0;
+    for (auto it = begin; it != end;) {
+      // Crossings at the same x are applied together, so spans of polygons
+      // sharing an edge are merged instead of split there
+      const double x = it->x;
+      const bool wasInside = isInside(winding, fillRule);
+      for (; it != end && it->x == x; ++it)
+        winding += it->winding;
+      const bool inside = isInside(winding, fillRule);
+
+      if (inside && !wasInside) {
+        spanStart = x;
+      } else if (!inside && wasInside) {
+        Point64 from = unrotate(spanStart, y);
+        Point64 to = unrotate(x, y);
+        if (from != to)
+          result.push_back({from, to});
+      }
+    }
+  }
+}
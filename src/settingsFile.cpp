@@ -0,0 +1,149 @@
+#include "settingsFile.h"
+
+#include <Nexus.h>
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+namespace {
+
+// Enums are read as ints in [0, count) and converted back by `assign`
+struct EnumValue {
+  std::function<void(int)> assign;
+  int count;
+};
+
+struct Setting {
+  std::variant<int *, float *, bool *, EnumValue> value;
+};
+
+template <typename T> Setting enumSetting(T &value, T count) {
+  return {EnumValue{[&value](int parsed) { value = static_cast<T>(parsed); },
+                    static_cast<int>(count)}};
+}
+
+std::unordered_map<std::string_view, Setting> getSettings(State &state) {
+  auto &slice = state.sliceSettings;
+  auto &printer = state.printerSettings;
+  auto &file = state.fileSettings;
+  return {
+      {"layerHeight", {&slice.layerHeight}},
+      {"shellCount", {&slice.shellCount}},
+      {"infillDensity", {&slice.infillDensity}},
+      {"floorCount", {&slice.floorCount}},
+      {"roofCount", {&slice.roofCount}},
+      {"retractDistance", {&slice.retractDistance}},
+      {"minimumRetractDistance", {&slice.minimumRetractDistance}},
+      {"enableSupport", {&slice.enableSupport}},
+      {"fillType", enumSetting(slice.fillType, FillCount)},
+      {"infillType", enumSetting(slice.infillType, InfillCount)},
+      {"supportType", enumSetting(slice.supportType, SupportCount)},
+      {"supportWallCount", {&slice.supportWallCount}},
+      {"supportBrimCount", {&slice.supportBrimCount}},
+      {"adhesionType", enumSetting(slice.adhesionType, AdhesionCount)},
+      {"brimLocation", enumSetting(slice.brimLocation, BrimLocationCount)},
+      {"brimLineCount", {&slice.brimLineCount}},
+      {"skirtHeight", {&slice.skirtHeight}},
+      {"skirtLineCount", {&slice.skirtLineCount}},
+      {"skirtDistance", {&slice.skirtDistance}},
+      {"extraShift", {&slice.extraShift}},
+      {"workerCount", {&slice.workerCount}},
+      {"bedTemp", {&printer.bedTemp}},
+      {"nozzleTemp", {&printer.nozzleTemp}},
+      {"nozzleDiameter", {&printer.nozzleDiameter}},
+      {"printSpeed", {&printer.printSpeed}},
+      {"infillSpeed", {&printer.infillSpeed}},
+      {"wallSpeed", {&printer.wallSpeed}},
+      {"initialLayerSpeed", {&printer.inititalLayerSpeed}},
+      {"bedWidth", {&printer.bedWidth}},
+      {"bedDepth", {&printer.bedDepth}},
+      {"useCache", {&file.useCache}},
+      {"cacheSizeMB", {&file.cacheSizeMB}},
+  };
+}
+
+std::string_view trim(std::string_view text) {
+  const auto first = text.find_first_not_of(" \t\r");
+  if (first == std::string_view::npos)
+    return {};
+  const auto last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+// Only assigns `value` when all of `text` is a number
+template <typename T> bool parseNumber(std::string_view text, T &value) {
+  T parsed;
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), parsed);
+  if (error != std::errc() || end != text.data() + text.size())
+    return false;
+  value = parsed;
+  return true;
+}
+
+bool parseValue(std::string_view text, const Setting &setting) {
+  if (auto *value = std::get_if<int *>(&setting.value))
+    return parseNumber(text, **value);
+  if (auto *value = std::get_if<EnumValue>(&setting.value)) {
+    int parsed;
+    if (!parseNumber(text, parsed) || parsed < 0 || parsed >= value->count)
+      return false;
+    value->assign(parsed);
+    return true;
+  }
+  if (auto *value = std::get_if<float *>(&setting.value))
+    return parseNumber(text, **value);
+
+  bool &flag = *std::get<bool *>(setting.value);
+  if (text == "true" || text == "1")
+    flag = true;
+  else if (text == "false" || text == "0")
+    flag = false;
+  else
+    return false;
+  return true;
+}
+
+} // namespace
+
+bool loadSettingsFile(const char *path, State &state) {
+  using namespace Nexus;
+
+  std::ifstream file(path);
+  if (!file) {
+    Logger::error("Could not open settings file {}", path);
+    return false;
+  }
+
+  const auto settings = getSettings(state);
+  std::string line;
+  for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+    const std::string_view text = trim(line);
+    if (text.empty() || text.front() == '#')
+      continue;
+
+    const auto separator = text.find('=');
+    if (separator == std::string_view::npos) {
+      Logger::error("{}:{}: expected key = value", path, lineNumber);
+      return false;
+    }
+    const auto key = trim(text.substr(0, separator));
+    const auto value = trim(text.substr(separator + 1));
+
+    const auto setting = settings.find(key);
+    if (setting == settings.end()) {
+      Logger::error("{}:{}: unknown setting {}", path, lineNumber, key);
+      return false;
+    }
+    if (!parseValue(value, setting->second)) {
+      Logger::error("{}:{}: invalid value {} for {}", path, lineNumber, value,
+                    key);
+      return false;
+    }
+  }
+  return true;
+}
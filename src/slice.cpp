@@ -1,12 +1,19 @@
 #include "slice.h"
 #include "utils.h"
+#include "workspace.h"
 
 #include <Nexus.h>
+#include <algorithm>
+#include <atomic>
 #include <clipper2/clipper.core.h>
 #include <clipper2/clipper.h>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
 #include <glm/fwd.hpp>
-#include <glm/gtc/matrix_transform.hpp>
 #include <sys/types.h>
 #include <vector>
 
@@ -27,235 +34,271 @@ bool Line::operator==(const Line &other) const {
 }
 
 Slice::Slice(std::vector<Line> &lineSegments) {
-  PathsD perimeter;
-  PathD path;
-  while (!lineSegments.empty()) {
-    if (path.empty()) {
-      path.push_back(lineSegments[0].p1);
-      path.push_back(lineSegments[0].p2);
-      lineSegments.erase(lineSegments.begin());
+  // Bucket both endpoints of every segment in a grid of EPSILON sized cells.
+  // Any endpoint closer than EPSILON to a point lies in one of the 3x3 cells
+  // around it, so finding the next segment of a loop only looks at a handful
+  // of candidates instead of every remaining segment.
+  auto cellOf = [](const PointD &point) -> std::pair<int32_t, int32_t> {
+    return {static_cast<int32_t>(std::floor(point.x / EPSILON)),
+            static_cast<int32_t>(std::floor(point.y / EPSILON))};
+  };
+  auto cellKey = [](int32_t x, int32_t y) -> uint64_t {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+           static_cast<uint32_t>(y);
+  };
+
+  // Endpoints are referenced as `segment * 2 + end`; each cell holds a linked
+  // list of the endpoints inside it. The lookup tables only live while the
+  // layer is stitched, so they come from the thread's arena.
+  std::pmr::memory_resource *arena = &Workspace::get().arena;
+  const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+  std::pmr::unordered_map<uint64_t, uint32_t> cells(arena);
+  cells.reserve(lineSegments.size() * 2);
+  std::pmr::vector<uint32_t> nextInCell(lineSegments.size() * 2, arena);
+  for (uint32_t i = 0; i < lineSegments.size(); ++i) {
+    for (uint32_t end = 0; end < 2; ++end) {
+      const auto &point = end == 0 ? lineSegments[i].p1 : lineSegments[i].p2;
+      auto [x, y] = cellOf(point);
+      auto [it, inserted] = cells.try_emplace(cellKey(x, y), NONE);
+      nextInCell[i * 2 + end] = it->second;
+      it->second = i * 2 + end;
     }
+  }
 
-    auto &firstPoint = path.front();
-    size_t currentPointsCount = path.size();
-
-    for (int i = 0; i < lineSegments.size(); ++i) {
-      auto line = lineSegments[i];
-      if (distance(path.back(), line.p1) < EPSILON) {
-        if (distance(firstPoint, line.p2) < EPSILON) {
-          path.push_back(firstPoint);
-          perimeter.emplace_back(SimplifyPath(path, 0.1));
-          path.clear();
-          lineSegments.erase(lineSegments.begin() + i);
-        } else {
-          path.push_back(line.p2);
-          lineSegments.erase(lineSegments.begin() + i);
-        }
-        break;
-      } else if (distance(path.back(), line.p2) < EPSILON) {
-        if (distance(firstPoint, line.p1) < EPSILON) {
-          path.push_back(firstPoint);
-          perimeter.emplace_back(SimplifyPath(path, 0.1));
-          path.clear();
-          lineSegments.erase(lineSegments.begin() + i);
-        } else {
-          path.push_back(line.p1);
-          lineSegments.erase(lineSegments.begin() + i);
+  std::pmr::vector<bool> used(lineSegments.size(), false, arena);
+
+  // Returns the lowest unused segment with an endpoint within EPSILON of
+  // `point`, the same segment a linear scan would find first.
+  auto findNext = [&](const PointD &point) -> uint32_t {
+    auto [cx, cy] = cellOf(point);
+    uint32_t best = NONE;
+    for (int32_t x = cx - 1; x <= cx + 1; ++x) {
+      for (int32_t y = cy - 1; y <= cy + 1; ++y) {
+        auto it = cells.find(cellKey(x, y));
+        if (it == cells.end())
+          continue;
+        for (uint32_t ref = it->second; ref != NONE; ref = nextInCell[ref]) {
+          const uint32_t i = ref / 2;
+          if (used[i] || i >= best)
+            continue;
+          const auto &line = lineSegments[i];
+          if (distance(point, ref % 2 == 0 ? line.p1 : line.p2) < EPSILON)
+            best = i;
         }
-        break;
       }
     }
-  }
-  perimeter = Clipper2Lib::Union(perimeter, FillRule::EvenOdd);
-  m_paths.emplace(OuterWall, std::vector<PathsD>{perimeter});
-}
-
-void Slice::clear() {
-  for (auto &pd : m_paths) {
-    for (auto vao : pd.second.VAOs)
-      glDeleteVertexArrays(1, &vao);
-  }
-  m_paths.clear();
-  m_supportArea = PathsD();
-}
+    return best;
+  };
 
-void Slice::addOuterWall(const PathsD &wall) {
-  if (!m_paths.contains(OuterWall))
-    m_paths.emplace(OuterWall, PathData());
-
-  auto &pd = m_paths.at(OuterWall);
-  pd.paths.push_back(wall);
-  initOpenGLBuffers(pd.VAOs, wall);
-}
+  PathsD perimeter;
+  PathD path;
+  size_t openContours = 0;
+  uint32_t firstUnused = 0;
+  while (true) {
+    if (path.empty()) {
+      while (firstUnused < lineSegments.size() && used[firstUnused])
+        ++firstUnused;
+      if (firstUnused == lineSegments.size())
+        break;
 
-const PathsD &Slice::getPerimeter() const {
-  return m_paths.at(OuterWall).paths.front();
-}
+      used[firstUnused] = true;
+      path.push_back(lineSegments[firstUnused].p1);
+      path.push_back(lineSegments[firstUnused].p2);
+    }
 
-const PathD Slice::getOuterMostPerimeter() const {
-  auto perimeters = m_paths.at(OuterWall).paths;
-  if (perimeters.empty()) {
-    return PathD(); // Return an empty path if there are no perimeters
-  }
+    const auto &firstPoint = path.front();
+    const uint32_t i = findNext(path.back());
+    if (i == NONE) {
+      // No segment continues this contour, the mesh is not closed here
+      ++openContours;
+      path.clear();
+      continue;
+    }
 
-  // for (auto &perimeter : perimeters) {
-  //   Nexus::Logger::debug("Perimeter area {}", Area(perimeter));
-  //   debugPrintPathsD(perimeter);
-  // }
-
-  // Initialize the outermost path with the first path
-  PathD outermostPath = perimeters.front().front();
-  double maxArea = Area(GetBounds(outermostPath).AsPath());
-
-  // Loop through all PathsD and then through each PathD to find the one with
-  // the largest area
-  for (const auto &paths : perimeters) {
-    for (const auto &path : paths) {
-      double currentArea = Area(GetBounds(path).AsPath());
-      if (currentArea > maxArea) {
-        outermostPath = path;
-        maxArea = currentArea;
-      }
+    used[i] = true;
+    const auto &line = lineSegments[i];
+    const auto &nextPoint =
+        distance(path.back(), line.p1) < EPSILON ? line.p2 : line.p1;
+    if (distance(firstPoint, nextPoint) < EPSILON) {
+      path.push_back(firstPoint);
+      perimeter.emplace_back(SimplifyPath(path, 0.1));
+      path.clear();
+    } else {
+      path.push_back(nextPoint);
     }
   }
+  lineSegments.clear();
 
-  return outermostPath;
-}
-
-void Slice::addInnerWall(const PathsD &shell) {
-  if (!m_paths.contains(InnerWall))
-    m_paths.emplace(InnerWall, PathData());
+  if (openContours > 0)
+    Nexus::Logger::warn("Discarded {} open contour(s) while stitching a slice",
+                        openContours);
 
-  auto &pd = m_paths.at(InnerWall);
-  pd.paths.push_back(shell);
-  initOpenGLBuffers(pd.VAOs, shell);
+  m_contour = Clipper2Lib::Union(toPaths64(perimeter), FillRule::EvenOdd);
 }
 
-const std::vector<PathsD> &Slice::getShells() const {
-  return m_paths.at(InnerWall).paths;
-}
-const PathsD &Slice::getInnermostShell() const {
-  return m_paths.at(InnerWall).paths.back();
-}
+Slice::Slice(const PathsD &contours) {
+  PathsD perimeter;
+  perimeter.reserve(contours.size());
+  for (const auto &contour : contours)
+    perimeter.emplace_back(SimplifyPath(contour, 0.1));
 
-void Slice::addFill(const PathsD &fill) {
-  if (!m_paths.contains(Skin))
-    m_paths.emplace(Skin, PathData());
+  m_contour = Clipper2Lib::Union(toPaths64(perimeter), FillRule::EvenOdd);
+}
 
-  auto &pd = m_paths.at(Skin);
-  pd.paths.push_back(fill);
-  initOpenGLBuffers(pd.VAOs, fill);
+void Slice::clearWalls() {
+  clearPaths(OuterWall);
+  clearPaths(InnerWall);
 }
 
-const std::vector<PathsD> &Slice::getFill() const {
-  return m_paths.at(Skin).paths;
+void Slice::clearFill() {
+  clearPaths(Skin);
+  m_fillArea = Paths64();
 }
 
-void Slice::addInfill(const PathsD &infill) {
-  if (!m_paths.contains(Infill))
-    m_paths.emplace(Infill, PathData());
+void Slice::clearInfill() { clearPaths(Infill); }
 
-  auto &pd = m_paths.at(Infill);
-  pd.paths.push_back(infill);
-  initOpenGLBuffers(pd.VAOs, infill);
+void Slice::clearSupport() {
+  clearPaths(Support);
+  m_supportArea = Paths64();
 }
 
-const std::vector<PathsD> &Slice::getInfill() const {
-  return m_paths.at(Infill).paths;
+void Slice::clearAdhesion() { clearPaths(Adhesion); }
+
+void Slice::clearStage(Stage stage) {
+  switch (stage) {
+  case Stage::Slices:
+    m_contour = Paths64();
+    break;
+  case Stage::Walls:
+    clearWalls();
+    break;
+  case Stage::Fill:
+    clearFill();
+    break;
+  case Stage::Infill:
+    clearInfill();
+    break;
+  case Stage::Support:
+    clearSupport();
+    break;
+  case Stage::Adhesion:
+    clearAdhesion();
+    break;
+  default:
+    break;
+  }
 }
 
-void Slice::addSupport(const PathsD &support) {
-  if (!m_paths.contains(Support))
-    m_paths.emplace(Support, PathData());
-
-  auto &pd = m_paths.at(Support);
-  pd.paths.push_back(support);
-  initOpenGLBuffers(pd.VAOs, support);
+void Slice::addPaths(PathType type, const Paths64 &paths) {
+  m_paths[type].append(paths);
+  touch(type);
 }
 
-const std::vector<PathsD> &Slice::getSupport() const {
-  return m_paths.at(Support).paths;
+void Slice::setPaths(PathType type, PathBuffer paths) {
+  m_paths[type] = std::move(paths);
+  touch(type);
 }
 
-void Slice::removeSupport() {
-  if (!m_paths.contains(Support))
-    return;
-  auto VAOs = m_paths.at(Support).VAOs;
-  glDeleteVertexArrays(VAOs.size(), VAOs.data());
-  m_paths.at(Support).paths.clear();
-  m_paths.at(Support).VAOs.clear();
+std::span<const Slice::PathType> Slice::getStagePathTypes(Stage stage) {
+  static constexpr PathType walls[]{OuterWall, InnerWall};
+  static constexpr PathType skin[]{Skin};
+  static constexpr PathType infill[]{Infill};
+  static constexpr PathType support[]{Support};
+  static constexpr PathType adhesion[]{Adhesion};
+  switch (stage) {
+  case Stage::Walls:
+    return walls;
+  case Stage::Fill:
+    return skin;
+  case Stage::Infill:
+    return infill;
+  case Stage::Support:
+    return support;
+  case Stage::Adhesion:
+    return adhesion;
+  default:
+    return {};
+  }
 }
 
-std::pair<glm::vec2, glm::vec2> Slice::getBounds() const {
-  auto [minX, minY, maxX, maxY] =
-      GetBounds(m_paths.at(InnerWall).paths.front());
-  return {{minX, minY}, {maxX, maxY}};
+void Slice::clearPaths(PathType type) {
+  m_paths[type].clear();
+  touch(type);
 }
 
-void Slice::render(Shader &shader, const glm::vec3 &position,
-                   const float &scale) const {
-  auto [min, max] = getBounds();
-  auto center = (min + max) / 2.0f;
-  glm::mat4 model = glm::mat4(1.0f);
-  model = glm::translate(model,
-                         position - scale * glm::vec3(center.x, 0, center.y));
-  model = glm::scale(model, glm::vec3(scale));
-  shader.setMat4("model", model);
-
-  size_t vaoIndex = 0;
-
-  if (m_paths.contains(OuterWall))
-    drawPaths(m_paths.at(OuterWall), shader, RED);
-
-  if (m_paths.contains(InnerWall))
-    drawPaths(m_paths.at(InnerWall), shader, GREEN);
-
-  if (m_paths.contains(Skin))
-    drawPaths(m_paths.at(Skin), shader, YELLOW);
+void Slice::touch(PathType type) {
+  static std::atomic<uint64_t> nextRevision{1};
+  m_revisions[type] = nextRevision.fetch_add(1, std::memory_order_relaxed);
+}
 
-  if (m_paths.contains(Infill))
-    drawPaths(m_paths.at(Infill), shader, ORANGE);
+void Slice::addOuterWall(const Paths64 &wall) { addPaths(OuterWall, wall); }
 
-  if (m_paths.contains(Support))
-    drawPaths(m_paths.at(Support), shader, BLUE);
+Paths64 Slice::getPerimeter() const {
+  const auto &walls = m_paths[OuterWall];
+  return walls.empty() ? Paths64() : walls.getGroup(0);
 }
 
-void Slice::initOpenGLBuffers(std::vector<uint> &VAOs, const PathsD &paths) {
-  for (auto path : paths) {
-    VAOs.push_back(initOpenGLBuffer(path));
+const Path64 Slice::getOuterMostPerimeter() const {
+  const auto &walls = m_paths[OuterWall];
+  if (walls.getPathCount() == 0) {
+    return Path64(); // Return an empty path if there are no perimeters
+  }
+
+  // The path with the largest bounding box
+  size_t outermost = 0;
+  double maxArea = -1.0;
+  for (size_t i = 0; i < walls.getPathCount(); ++i) {
+    const auto path = walls.getPath(i);
+    double currentArea =
+        Area(GetBounds(Path64(path.begin(), path.end())).AsPath());
+    if (currentArea > maxArea) {
+      outermost = i;
+      maxArea = currentArea;
+    }
   }
+
+  const auto path = walls.getPath(outermost);
+  return Path64(path.begin(), path.end());
 }
 
-uint Slice::initOpenGLBuffer(const PathD &path) {
-  uint VAO, VBO;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
+void Slice::addInnerWall(const Paths64 &shell) { addPaths(InnerWall, shell); }
 
-  glBindVertexArray(VAO);
+Paths64 Slice::getInnermostShell() const {
+  const auto &shells = m_paths[InnerWall];
+  return shells.empty() ? Paths64()
+                        : shells.getGroup(shells.getGroupCount() - 1);
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, path.size() * sizeof(PointD), path.data(),
-               GL_STATIC_DRAW);
+void Slice::addFill(const Paths64 &fill) { addPaths(Skin, fill); }
 
-  glVertexAttribPointer(0, 2, GL_DOUBLE, GL_FALSE, sizeof(PointD), (void *)0);
-  glEnableVertexAttribArray(0);
+void Slice::addInfill(const Paths64 &infill) { addPaths(Infill, infill); }
 
-  glBindVertexArray(0);
-  return VAO;
-}
+void Slice::addSupport(const Paths64 &support) { addPaths(Support, support); }
 
-void Slice::drawPaths(const PathData &pd, Shader &shader,
-                      glm::vec3 color) const {
-  shader.use();
-  shader.setVec3("color", color);
-  size_t vaoIndex = 0;
-  for (auto &paths : pd.paths)
-    for (auto &path : paths)
-      drawPath(path, pd.VAOs[vaoIndex++]);
+void Slice::addAdhesion(const Paths64 &adhesion) {
+  addPaths(Adhesion, adhesion);
 }
 
-void Slice::drawPath(const PathD &path, uint vao) const {
-  glBindVertexArray(vao);
-  glDrawArrays(GL_LINE_STRIP, 0, path.size());
-  glBindVertexArray(0);
+std::pair<glm::vec2, glm::vec2> Slice::getBounds() const {
+  const auto &shells = m_paths[InnerWall];
+  if (shells.empty())
+    return {};
+
+  // Bounds of the points of the first inner wall
+  const auto [first, last] = shells.getGroupRange(0);
+  const size_t begin = shells.getPathBegin(first);
+  const size_t end = shells.getPathBegin(last);
+  if (begin == end)
+    return {};
+
+  const auto &points = shells.getPoints();
+  int64_t minX = std::numeric_limits<int64_t>::max(), minY = minX;
+  int64_t maxX = std::numeric_limits<int64_t>::min(), maxY = maxX;
+  for (size_t i = begin; i < end; ++i) {
+    minX = std::min(minX, points[i].x);
+    minY = std::min(minY, points[i].y);
+    maxX = std::max(maxX, points[i].x);
+    maxY = std::max(maxY, points[i].y);
+  }
+  return {{INT2MM(minX), INT2MM(minY)}, {INT2MM(maxX), INT2MM(maxY)}};
 }
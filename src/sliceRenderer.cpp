@@ -0,0 +1,82 @@
+#include "sliceRenderer.h"
+#include "utils.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+SliceRenderer::~SliceRenderer() {
+  for (auto &gl : m_buffers) {
+    if (gl.VAO == 0)
+      continue;
+    glDeleteVertexArrays(1, &gl.VAO);
+    glDeleteBuffers(1, &gl.VBO);
+  }
+}
+
+void SliceRenderer::render(const Slice &slice, Shader &shader,
+                           const glm::vec3 &position, float scale) {
+  auto [min, max] = slice.getBounds();
+  auto center = (min + max) / 2.0f;
+  glm::mat4 model = glm::mat4(1.0f);
+  model = glm::translate(model,
+                         position - scale * glm::vec3(center.x, 0, center.y));
+  model = glm::scale(model, glm::vec3(scale));
+  shader.setMat4("model", model);
+
+  static const std::array<glm::vec3, Slice::PathTypeCount> colors{
+      RED, GREEN, YELLOW, ORANGE, BLUE, BLUE};
+  for (size_t i = 0; i < Slice::PathTypeCount; ++i) {
+    const auto type = static_cast<Slice::PathType>(i);
+    if (slice.getPaths(type).empty())
+      continue;
+    if (m_buffers[type].VAO == 0 ||
+        m_buffers[type].revision != slice.getRevision(type))
+      upload(slice, type);
+    draw(type, shader, colors[type]);
+  }
+}
+
+void SliceRenderer::upload(const Slice &slice, Slice::PathType type) {
+  const auto &buffer = slice.getPaths(type);
+  auto &gl = m_buffers[type];
+
+  std::vector<glm::vec2> points;
+  points.reserve(buffer.getPoints().size());
+  for (const auto &point : buffer.getPoints())
+    points.emplace_back(INT2MM(point.x), INT2MM(point.y));
+
+  gl.firsts.clear();
+  gl.counts.clear();
+  for (size_t i = 0; i < buffer.getPathCount(); ++i) {
+    gl.firsts.push_back(static_cast<GLint>(buffer.getPathBegin(i)));
+    gl.counts.push_back(
+        static_cast<GLsizei>(buffer.getPathEnd(i) - buffer.getPathBegin(i)));
+  }
+
+  if (gl.VAO == 0) {
+    glGenVertexArrays(1, &gl.VAO);
+    glGenBuffers(1, &gl.VBO);
+
+    glBindVertexArray(gl.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, gl.VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2),
+                          (void *)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, gl.VBO);
+  glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(glm::vec2),
+               points.data(), GL_STATIC_DRAW);
+  gl.revision = slice.getRevision(type);
+}
+
+void SliceRenderer::draw(Slice::PathType type, Shader &shader,
+                         glm::vec3 color) const {
+  shader.use();
+  shader.setVec3("color", color);
+  const auto &gl = m_buffers[type];
+  glBindVertexArray(gl.VAO);
+  glMultiDrawArrays(GL_LINE_STRIP, gl.firsts.data(), gl.counts.data(),
+                    static_cast<GLsizei>(gl.counts.size()));
+  glBindVertexArray(0);
+}
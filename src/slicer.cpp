@@ -1,15 +1,20 @@
 #include "slicer.h"
+#include "hash.h"
 #include "model.h"
+#include "scanline.h"
 #include "utils.h"
+#include "workspace.h"
 
+#include <Nexus.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <clipper2/clipper.core.h>
 #include <clipper2/clipper.engine.h>
 #include <clipper2/clipper.h>
 #include <clipper2/clipper.offset.h>
 #include <cstdint>
 #include <glm/trigonometric.hpp>
-#include <hfs/hfs_format.h>
 #include <memory>
 #include <numbers>
 #include <sys/types.h>
@@ -17,11 +22,12 @@
 using namespace Clipper2Lib;
 
 Slicer::Slicer(const char *modelPath)
-    : m_model(std::make_unique<Model>(modelPath)) {}
+    : m_model(std::make_unique<Model>(modelPath, m_threadPool)) {}
 
 void Slicer::loadModel(const char *modelPath) {
-  m_model = std::make_unique<Model>(modelPath);
+  m_model = std::make_unique<Model>(modelPath, m_threadPool);
   m_slices.clear();
+  m_settings.reset();
 }
 
 void Slicer::init(float layerHeight, float nozzleDiameter) {
@@ -31,110 +37,734 @@ void Slicer::init(float layerHeight, float nozzleDiameter) {
   m_shift = m_lineWidth / 2;
 }
 
-void Slicer::createSlices() {
-  m_slices.clear();
+void Slicer::setWorkerCount(size_t workerCount) {
+  m_threadPool.setWorkerCount(workerCount);
+}
+
+void Slicer::setCache(std::filesystem::path directory, uint64_t maxBytes) {
+  m_cache.setDirectory(std::move(directory), maxBytes);
+}
+
+static constexpr uint32_t stageBit(Stage stage) {
+  return 1u << static_cast<uint32_t>(stage);
+}
+
+// The stages whose output every stage reads
+static constexpr std::array<uint32_t, STAGE_COUNT> STAGE_INPUTS{
+    0,                                                 // Slices
+    stageBit(Stage::Slices),                           // Walls
+    stageBit(Stage::Walls),                            // Fill
+    stageBit(Stage::Fill),                             // Infill
+    stageBit(Stage::Walls),                            // Support
+    stageBit(Stage::Walls) | stageBit(Stage::Support), // Adhesion
+};
 
-  for (size_t i = 0; i < m_layerCount; ++i) {
-    auto sliceHeight = m_layerHeight / 2.0f + m_layerHeight * i + 1e-15;
-    m_slices.push_back(m_model->getSlice(sliceHeight));
+static constexpr uint32_t ALL_STAGES = (1u << STAGE_COUNT) - 1;
+
+uint32_t Slicer::getDirtyStages(const PipelineSettings &settings) const {
+  // Stages are declared in dependency order, so one pass finds them all
+  uint32_t dirty = 0;
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    if (!m_settings || hasChanged(stage, settings) ||
+        (STAGE_INPUTS[i] & dirty))
+      dirty |= stageBit(stage);
   }
+  return dirty;
 }
 
-void Slicer::createWalls(int wallCount) {
-  for (auto &slice : m_slices) {
-    auto objectPerimeter = toPaths64(slice.getPerimeter());
-    slice.clear();
-
-    for (size_t j = 0; j < wallCount; ++j) {
-      double delta = -static_cast<double>(m_lineWidth) / 2.0 -
-                     static_cast<double>(m_lineWidth * j);
-      Paths64 wall = InflatePaths(objectPerimeter, delta, JoinType::Round,
-                                  EndType::Polygon);
-      if (j == 0)
-        slice.addOuterWall(toPathsD(closePaths(wall)));
-      else
-        slice.addInnerWall(toPathsD(closePaths(wall)));
+bool Slicer::slice(const PipelineSettings &settings, JobProgress *progress,
+                   LayerFeed *feed) {
+  // Stages left unfinished by getSlice() run again as a whole
+  uint32_t dirty = getDirtyStages(settings);
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    if (!isStageComplete(stage) || (STAGE_INPUTS[i] & dirty))
+      dirty |= stageBit(stage);
+  }
+
+  m_progress = progress;
+  m_feed = feed;
+  m_extraShift = settings.extraShift;
+  std::array<uint64_t, STAGE_COUNT> keys{};
+  if (m_cache.isEnabled())
+    keys = getStageKeys(settings);
+
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    if (!(dirty & stageBit(stage))) {
+      Nexus::Logger::debug("Reusing {}", getStageName(stage));
+      continue;
+    }
+
+    // The layer count is only known once the slices are set up
+    if (stage == Stage::Slices) {
+      init(settings.slices.layerHeight, settings.slices.nozzleDiameter);
+      m_layerStages.assign(m_layerCount, 0);
     }
+    if (m_progress)
+      m_progress->beginTask(getStageName(stage), m_layerCount);
+
+    if (m_cache.isEnabled()) {
+      // Entries hold one stage for every layer, so the layers have to exist
+      // before the slices can be loaded
+      if (stage == Stage::Slices)
+        m_slices.assign(m_layerCount, Slice());
+      if (m_cache.load(stage, keys[i], m_slices)) {
+        Nexus::Logger::info("Loaded {} from the cache", getStageName(stage));
+        if (stage == Stage::Slices)
+          resetPatternCache();
+        markStage(stage, 0, m_layerCount);
+        for (size_t layer = 0; layer < m_slices.size(); ++layer)
+          publishLayer(layer, stage);
+        continue;
+      }
+    }
+
+    Nexus::Logger::info("Creating {}", getStageName(stage));
+    runStage(stage, settings);
+    if (isCancelled()) {
+      Nexus::Logger::info("Cancelled while creating {}", getStageName(stage));
+      // Stages may now hold the output of settings that are not recorded
+      m_settings.reset();
+      m_progress = nullptr;
+      m_feed = nullptr;
+      return false;
+    }
+    if (m_cache.isEnabled())
+      m_cache.store(stage, keys[i], m_slices);
+    markStage(stage, 0, m_layerCount);
+
+    // The adhesion is not made layer by layer
+    if (stage == Stage::Adhesion)
+      for (size_t layer = 0; layer < m_slices.size(); ++layer)
+        publishLayer(layer, stage);
   }
+  if (m_cache.isEnabled())
+    m_cache.logStats();
+
+  m_settings = settings;
+  m_slicedPosition = m_model->getPosition();
+  m_slicedRotation = m_model->getRotation();
+  m_slicedScale = m_model->getScale();
+  m_progress = nullptr;
+  m_feed = nullptr;
+  return true;
 }
 
-void Slicer::createFill(FillType fillType, int floorCount, int roofCount) {
-  if (fillType == NoFill)
-    return;
+void Slicer::prepare(const PipelineSettings &settings, JobProgress *progress) {
+  const uint32_t dirty = getDirtyStages(settings);
 
-  floorCount = std::clamp<int>(floorCount, 0, m_layerCount);
-  roofCount = std::clamp<int>(roofCount, 0, m_layerCount - floorCount);
+  m_progress = progress;
+  m_feed = nullptr;
+  m_extraShift = settings.extraShift;
+  std::array<uint64_t, STAGE_COUNT> keys{};
+  if (m_cache.isEnabled())
+    keys = getStageKeys(settings);
 
-  // First `floorCount` layers are always filled
-  for (size_t i = 0; i < floorCount; ++i) {
-    auto &slice = m_slices[i];
-    Paths64 fill;
-    m_currentArea = toPaths64(slice.getInnermostShell());
-    generateFill(fill, fillType, i % 2 == 0 ? 45.0 : 135.0);
-    slice.addFill(toPathsD(fill));
-    slice.setFillArea(slice.getInnermostShell());
+  if (dirty & stageBit(Stage::Slices)) {
+    init(settings.slices.layerHeight, settings.slices.nozzleDiameter);
+    m_slices.assign(m_layerCount, Slice());
+    m_layerStages.assign(m_layerCount, 0);
+    resetPatternCache();
   }
 
-  for (size_t i = floorCount; i < m_layerCount - roofCount; ++i) {
-    auto &slice = m_slices[i];
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    if (!(dirty & stageBit(stage)))
+      continue;
 
-    // Find floor sections;
-    PathsD floorArea = m_slices[i - 1].getInnermostShell();
-    for (size_t j = 2; j <= floorCount; ++j) {
-      floorArea = Intersect(floorArea, m_slices[i - j].getInnermostShell(),
-                            FillRule::EvenOdd);
+    for (size_t layer = 0; layer < m_layerCount; ++layer) {
+      m_slices[layer].clearStage(stage);
+      m_layerStages[layer] &= ~stageBit(stage);
     }
-    floorArea =
-        Difference(slice.getInnermostShell(), floorArea, FillRule::EvenOdd);
-    m_currentArea = toPaths64(floorArea);
-    Paths64 floor;
-    generateFill(floor, fillType, i % 2 == 0 ? 45.0 : 135.0);
-
-    PathsD roofArea;
-    if (i + 1 >= m_layerCount)
-      roofArea = PathsD();
+    // Entries hold every layer, loading one costs less than any layer
+    if (m_cache.isEnabled() && m_cache.load(stage, keys[i], m_slices)) {
+      Nexus::Logger::info("Loaded {} from the cache", getStageName(stage));
+      markStage(stage, 0, m_layerCount);
+    }
+  }
+
+  m_settings = settings;
+  m_slicedPosition = m_model->getPosition();
+  m_slicedRotation = m_model->getRotation();
+  m_slicedScale = m_model->getScale();
+}
+
+const Slice &Slicer::getSlice(size_t index) {
+  if (m_settings && index < m_layerCount &&
+      m_layerStages[index] != ALL_STAGES) {
+    ensureWalls(index, index + 1);
+    ensureFill(index, index + 1);
+    ensureInfill(index, index + 1);
+    ensureSupport(index);
+    ensureAdhesion(index, index + 1);
+  }
+  return m_slices.at(index);
+}
+
+bool Slicer::isStageComplete(Stage stage) const {
+  return std::all_of(m_layerStages.begin(), m_layerStages.end(),
+                     [&](uint32_t stages) { return stages & stageBit(stage); });
+}
+
+void Slicer::markStage(Stage stage, size_t first, size_t last) {
+  for (size_t layer = first; layer < last; ++layer)
+    m_layerStages[layer] |= stageBit(stage);
+}
+
+std::vector<size_t> Slicer::getMissingLayers(Stage stage, size_t first,
+                                             size_t last) const {
+  std::vector<size_t> layers;
+  for (size_t layer = first; layer < last; ++layer)
+    if (!(m_layerStages[layer] & stageBit(stage)))
+      layers.push_back(layer);
+  return layers;
+}
+
+void Slicer::ensureSlices(size_t first, size_t last) {
+  const auto layers = getMissingLayers(Stage::Slices, first, last);
+  if (layers.empty())
+    return;
+
+  std::vector<double> sliceHeights;
+  sliceHeights.reserve(layers.size());
+  for (const size_t layer : layers)
+    sliceHeights.push_back(getSliceHeight(layer));
+  auto slices = m_model->getSlices(sliceHeights, m_threadPool, m_progress,
+                                   &m_stageCounters);
+  // Layers left once cancelled are empty, not sliced
+  if (isCancelled())
+    return;
+
+  for (size_t i = 0; i < layers.size(); ++i) {
+    m_slices[layers[i]] = std::move(slices[i]);
+    markStage(Stage::Slices, layers[i], layers[i] + 1);
+  }
+}
+
+void Slicer::ensureWalls(size_t first, size_t last) {
+  const auto layers = getMissingLayers(Stage::Walls, first, last);
+  if (layers.empty())
+    return;
+  ensureSlices(first, last);
+
+  m_threadPool.parallelFor(layers.size(), [&](size_t i) {
+    if (isCancelled())
+      return;
+    createLayerWalls(layers[i], m_settings->walls.shellCount);
+    markStage(Stage::Walls, layers[i], layers[i] + 1);
+  });
+}
+
+void Slicer::ensureFill(size_t first, size_t last) {
+  const auto layers = getMissingLayers(Stage::Fill, first, last);
+  if (layers.empty())
+    return;
+
+  const auto &settings = m_settings->fill;
+  if (settings.fillType == NoFill) {
+    markStage(Stage::Fill, first, last);
+    return;
+  }
+
+  // Same windows as createFill, intersected for the missing layers only
+  const size_t floorCount = std::clamp<int>(settings.floorCount, 0,
+                                            m_layerCount);
+  const size_t roofCount = std::clamp<int>(settings.roofCount, 0,
+                                           m_layerCount - floorCount);
+  const size_t floorWindow = std::max<size_t>(floorCount, 1);
+  const size_t roofWindow = std::max<size_t>(roofCount, 1);
+  ensureWalls(first - std::min(first, floorWindow),
+              std::min(last + roofWindow, m_layerCount));
+
+  m_threadPool.parallelFor(layers.size(), [&](size_t i) {
+    if (isCancelled())
+      return;
+    const size_t layer = layers[i];
+    auto &workspace = Workspace::get();
+    auto intersect = [&](size_t begin, size_t end) {
+      Paths64 area = m_slices[begin].getInnermostShell();
+      for (size_t j = begin + 1; j < end; ++j)
+        area = workspace.clip(ClipType::Intersection, FillRule::EvenOdd, area,
+                              m_slices[j].getInnermostShell());
+      return area;
+    };
+
+    const bool alwaysFilled =
+        layer < floorCount || layer >= m_layerCount - roofCount;
+    Paths64 below, above;
+    if (!alwaysFilled && layer >= floorWindow)
+      below = intersect(layer - floorWindow, layer);
+    if (!alwaysFilled && layer + roofWindow < m_layerCount)
+      above = intersect(layer + 1, layer + 1 + roofWindow);
+    createLayerFill(layer, settings.fillType, floorCount, roofCount,
+                    m_slices[layer].getInnermostShell(), below, above);
+    markStage(Stage::Fill, layer, layer + 1);
+  });
+}
+
+void Slicer::ensureInfill(size_t first, size_t last) {
+  const auto layers = getMissingLayers(Stage::Infill, first, last);
+  if (layers.empty())
+    return;
+
+  const auto &settings = m_settings->infill;
+  if (settings.infillType == NoInfill || settings.density <= 0.0f) {
+    markStage(Stage::Infill, first, last);
+    return;
+  }
+  ensureWalls(first, last);
+  ensureFill(first, last);
+
+  m_threadPool.parallelFor(layers.size(), [&](size_t i) {
+    if (isCancelled())
+      return;
+    createLayerInfill(layers[i], settings.infillType, settings.density);
+    markStage(Stage::Infill, layers[i], layers[i] + 1);
+  });
+}
+
+void Slicer::ensureSupport(size_t first) {
+  const auto layers = getMissingLayers(Stage::Support, first, m_layerCount);
+  if (layers.empty())
+    return;
+
+  const auto &settings = m_settings->support;
+  if (!settings.enabled || settings.supportType == NoSupport) {
+    markStage(Stage::Support, 0, m_layerCount);
+    return;
+  }
+
+  // Every layer grows the support of the one above it, so the layers are
+  // done from the top down to `first`. The done layers are always the top
+  // ones, the chain continues below the lowest of them.
+  ensureWalls(first, m_layerCount);
+  if (isCancelled())
+    return;
+  const bool firstLayerSupport = m_settings->adhesion.adhesionType != Brim;
+  for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+    if (isCancelled())
+      return;
+    if (*layer == m_layerCount - 1)
+      m_slices.back().setSupportArea(Paths64());
     else
-      roofArea = m_slices[i + 1].getInnermostShell();
+      createLayerSupport(*layer, settings.supportType, settings.density,
+                         settings.wallCount, settings.brimWallCount,
+                         firstLayerSupport);
+    markStage(Stage::Support, *layer, *layer + 1);
+  }
+}
+
+void Slicer::ensureAdhesion(size_t first, size_t last) {
+  const auto layers = getMissingLayers(Stage::Adhesion, first, last);
+  if (layers.empty())
+    return;
+
+  // The adhesion is made from the first layer and added to the `height`
+  // layers starting at it
+  const auto &settings = m_settings->adhesion;
+  size_t height = 0;
+  if (settings.adhesionType == Brim)
+    height = 1;
+  else if (settings.adhesionType == Skirt)
+    height = std::max(settings.skirtHeight, 1);
+  height = std::min(height, m_layerCount);
+
+  if (first < height) {
+    // All `height` layers must be sliced first, slicing a layer later would
+    // replace its Slice and drop the adhesion added to it
+    ensureWalls(0, height);
+    // The skirt goes around the support of the first layer as well
+    if (settings.adhesionType == Skirt)
+      ensureSupport(0);
+    if (isCancelled())
+      return;
+
+    if (settings.adhesionType == Brim)
+      createBrim(settings.brimLocation, settings.brimLineCount);
+    else
+      createSkirt(settings.skirtLineCount, settings.skirtHeight,
+                  settings.skirtDistance);
+    markStage(Stage::Adhesion, 0, height);
+  }
+  markStage(Stage::Adhesion, std::max(first, height), last);
+}
 
-    for (size_t j = 2; j <= roofCount; ++j) {
-      roofArea = Intersect(roofArea, m_slices[i + j].getInnermostShell(),
-                           FillRule::EvenOdd);
+void Slicer::forEachLayer(Stage stage,
+                          const std::function<void(size_t)> &task) {
+  m_threadPool.parallelFor(m_slices.size(), [&](size_t i) {
+    if (!beginLayer())
+      return;
+    task(i);
+    publishLayer(i, stage);
+  });
+}
+
+void Slicer::publishLayer(size_t index, Stage stage) const {
+  if (!m_feed)
+    return;
+  for (const auto type : Slice::getStagePathTypes(stage))
+    m_feed->publish(index, m_slices.size(), type,
+                    m_slices[index].getPaths(type));
+}
+
+std::shared_ptr<const SliceResult> Slicer::getResult() const {
+  if (!m_settings || m_layerStages.size() != m_slices.size() ||
+      !std::all_of(m_layerStages.begin(), m_layerStages.end(),
+                   [](uint32_t stages) { return stages == ALL_STAGES; }))
+    return nullptr;
+  return std::make_shared<const SliceResult>(
+      SliceResult{*m_settings, m_slices});
+}
+
+bool Slicer::hasChanged(Stage stage, const PipelineSettings &settings) const {
+  // Every line pattern is offset by the extra shift
+  const bool shiftChanged = settings.extraShift != m_settings->extraShift;
+  switch (stage) {
+  case Stage::Slices:
+    return settings.slices != m_settings->slices ||
+           m_model->getPosition() != m_slicedPosition ||
+           m_model->getRotation() != m_slicedRotation ||
+           m_model->getScale() != m_slicedScale;
+  case Stage::Walls:
+    return settings.walls != m_settings->walls;
+  case Stage::Fill:
+    return settings.fill != m_settings->fill || shiftChanged;
+  case Stage::Infill:
+    return settings.infill != m_settings->infill || shiftChanged;
+  case Stage::Support:
+    // A brim replaces the support on the first layer
+    return settings.support != m_settings->support || shiftChanged ||
+           (settings.adhesion.adhesionType == Brim) !=
+               (m_settings->adhesion.adhesionType == Brim);
+  case Stage::Adhesion:
+    return settings.adhesion != m_settings->adhesion;
+  default:
+    return true;
+  }
+}
+
+std::array<uint64_t, STAGE_COUNT>
+Slicer::getStageKeys(const PipelineSettings &settings) {
+  // Bump when the output of any stage changes for the same inputs
+  static constexpr uint32_t PIPELINE_VERSION = 3;
+  // Build options that change the output. Both intersection kernels give
+  // the same segments, so the one picked at runtime is left out.
+#ifdef SLICER_CLIPPER_LINES
+  static constexpr bool CLIPPER_LINES = true;
+#else
+  static constexpr bool CLIPPER_LINES = false;
+#endif
+
+  std::array<uint64_t, STAGE_COUNT> keys{};
+  for (size_t i = 0; i < STAGE_COUNT; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    Fnv1a hash;
+    hash.add(PIPELINE_VERSION);
+    hash.add(CLIPPER_LINES);
+    hash.add(stage);
+    for (size_t input = 0; input < i; ++input)
+      if (STAGE_INPUTS[i] & stageBit(static_cast<Stage>(input)))
+        hash.add(keys[input]);
+
+    switch (stage) {
+    case Stage::Slices: {
+      hash.add(m_model->getContentHash());
+      for (const auto &vector : {m_model->getPosition(),
+                                 m_model->getRotation(), m_model->getScale()})
+        for (int axis = 0; axis < 3; ++axis)
+          hash.add(vector[axis]);
+      hash.add(settings.slices.layerHeight);
+      hash.add(settings.slices.nozzleDiameter);
+      break;
     }
-    roofArea =
-        Difference(slice.getInnermostShell(), roofArea, FillRule::EvenOdd);
-    m_currentArea = toPaths64(roofArea);
-    Paths64 roof;
-    generateFill(roof, fillType, i % 2 == 0 ? 45.0 : 135.0);
+    case Stage::Walls:
+      hash.add(settings.walls.shellCount);
+      break;
+    case Stage::Fill:
+      hash.add(settings.fill.fillType);
+      hash.add(settings.fill.floorCount);
+      hash.add(settings.fill.roofCount);
+      hash.add(settings.extraShift);
+      break;
+    case Stage::Infill:
+      hash.add(settings.infill.infillType);
+      hash.add(settings.infill.density);
+      hash.add(settings.extraShift);
+      break;
+    case Stage::Support: {
+      const auto &support = settings.support;
+      hash.add(support.enabled);
+      hash.add(support.supportType);
+      hash.add(support.density);
+      hash.add(support.wallCount);
+      hash.add(support.brimWallCount);
+      hash.add(settings.extraShift);
+      hash.add(settings.adhesion.adhesionType == Brim);
+      break;
+    }
+    case Stage::Adhesion: {
+      const auto &adhesion = settings.adhesion;
+      hash.add(adhesion.adhesionType);
+      hash.add(adhesion.brimLocation);
+      hash.add(adhesion.brimLineCount);
+      hash.add(adhesion.skirtLineCount);
+      hash.add(adhesion.skirtHeight);
+      hash.add(adhesion.skirtDistance);
+      break;
+    }
+    default:
+      break;
+    }
+    keys[i] = hash.get();
+  }
+  return keys;
+}
 
-    slice.addFill(toPathsD(floor));
-    slice.addFill(toPathsD(roof));
+void Slicer::runStage(Stage stage, const PipelineSettings &settings) {
+  switch (stage) {
+  case Stage::Slices:
+    init(settings.slices.layerHeight, settings.slices.nozzleDiameter);
+    createSlices();
+    break;
+  case Stage::Walls:
+    createWalls(settings.walls.shellCount);
+    break;
+  case Stage::Fill:
+    for (auto &slice : m_slices)
+      slice.clearFill();
+    createFill(settings.fill.fillType, settings.fill.floorCount,
+               settings.fill.roofCount);
+    break;
+  case Stage::Infill:
+    for (auto &slice : m_slices)
+      slice.clearInfill();
+    if (settings.infill.density > 0.0f)
+      createInfill(settings.infill.infillType, settings.infill.density);
+    break;
+  case Stage::Support: {
+    for (auto &slice : m_slices)
+      slice.clearSupport();
+    const auto &support = settings.support;
+    if (support.enabled)
+      createSupport(support.supportType, support.density, support.wallCount,
+                    support.brimWallCount,
+                    settings.adhesion.adhesionType != Brim);
+    break;
+  }
+  case Stage::Adhesion: {
+    for (auto &slice : m_slices)
+      slice.clearAdhesion();
+    const auto &adhesion = settings.adhesion;
+    switch (adhesion.adhesionType) {
+    case Brim:
+      createBrim(adhesion.brimLocation, adhesion.brimLineCount);
+      break;
+    case Skirt:
+      createSkirt(adhesion.skirtLineCount, adhesion.skirtHeight,
+                  adhesion.skirtDistance);
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void Slicer::createSlices() {
+  m_slices.clear();
+
+  std::vector<double> sliceHeights;
+  sliceHeights.reserve(m_layerCount);
+  for (size_t i = 0; i < m_layerCount; ++i)
+    sliceHeights.push_back(getSliceHeight(i));
 
-    auto fillArea = Union(floorArea, roofArea, FillRule::NonZero);
-    slice.setFillArea(fillArea);
+  m_slices = m_model->getSlices(sliceHeights, m_threadPool, m_progress,
+                                &m_stageCounters);
+  m_stageCounters.log(Stage::Slices);
+  resetPatternCache();
+}
+
+double Slicer::getSliceHeight(size_t layer) const {
+  return m_layerHeight / 2.0f + m_layerHeight * layer + 1e-15;
+}
+
+void Slicer::resetPatternCache() {
+  // Infill patterns cover the whole model, with room for the horizontal
+  // expansion of the support. The bounds come from the mesh rather than the
+  // slices, so they are known before any layer is sliced.
+  const auto [min, max] = m_model->getWorldBounds();
+  Rect64 bounds;
+  if (min.x <= max.x) {
+    // Slices lie in the x-z plane of the world
+    bounds = Rect64(MM2INT(min.x), MM2INT(min.z), MM2INT(max.x),
+                    MM2INT(max.z));
+    bounds.left -= 4 * m_lineWidth;
+    bounds.top -= 4 * m_lineWidth;
+    bounds.right += 4 * m_lineWidth;
+    bounds.bottom += 4 * m_lineWidth;
   }
+  m_patternCache.reset(bounds);
+}
+
+void Slicer::createWalls(int wallCount) {
+  // Every layer only reads its own perimeter
+  forEachLayer(Stage::Walls,
+               [&](size_t i) { createLayerWalls(i, wallCount); });
+  m_stageCounters.log(Stage::Walls);
+}
+
+void Slicer::createLayerWalls(size_t i, int wallCount) {
+  LayerScope scope(&m_stageCounters, Stage::Walls);
+  auto &offset = Workspace::get().offset;
+
+  auto &slice = m_slices[i];
+  offset.Clear();
+  offset.AddPaths(slice.getContour(), JoinType::Round, EndType::Polygon);
+  slice.clearWalls();
+
+  Paths64 wall;
+  for (size_t j = 0; j < wallCount; ++j) {
+    double delta = -static_cast<double>(m_lineWidth) / 2.0 -
+                   static_cast<double>(m_lineWidth * j);
+    offset.Execute(delta, wall);
+    if (j == 0)
+      slice.addOuterWall(closePaths(wall));
+    else
+      slice.addInnerWall(closePaths(wall));
+  }
+}
+
+// Intersection of every `windowSize` consecutive areas, indexed by the first
+// area of the window. The areas are split into blocks of `windowSize` with
+// running intersections from both ends of each block. Any window is then the
+// suffix of one block intersected with the prefix of the next, so it costs
+// three intersections per layer however large the window is.
+static std::vector<Paths64>
+intersectWindows(const std::vector<const Paths64 *> &areas, size_t windowSize,
+                 ThreadPool &threadPool) {
+  const size_t count = areas.size();
+  if (windowSize == 0 || windowSize > count)
+    return {};
 
-  // Last `roofCount` layers are always filled
-  for (size_t i = m_layerCount - roofCount; i < m_layerCount; ++i) {
-    auto &slice = m_slices[i];
-    m_currentArea = toPaths64(slice.getInnermostShell());
+  std::vector<Paths64> prefix(count);
+  std::vector<Paths64> suffix(count);
+  const size_t blockCount = (count + windowSize - 1) / windowSize;
+  threadPool.parallelFor(blockCount, [&](size_t block) {
+    const size_t begin = block * windowSize;
+    const size_t end = std::min(begin + windowSize, count);
+    auto &workspace = Workspace::get();
+    prefix[begin] = *areas[begin];
+    for (size_t i = begin + 1; i < end; ++i)
+      prefix[i] = workspace.clip(ClipType::Intersection, FillRule::EvenOdd,
+                                 prefix[i - 1], *areas[i]);
+    suffix[end - 1] = *areas[end - 1];
+    for (size_t i = end - 1; i-- > begin;)
+      suffix[i] = workspace.clip(ClipType::Intersection, FillRule::EvenOdd,
+                                 *areas[i], suffix[i + 1]);
+  });
+
+  std::vector<Paths64> windows(count - windowSize + 1);
+  threadPool.parallelFor(windows.size(), [&](size_t first) {
+    if (first % windowSize == 0)
+      windows[first] = std::move(suffix[first]);
+    else
+      windows[first] = Workspace::get().clip(
+          ClipType::Intersection, FillRule::EvenOdd, suffix[first],
+          prefix[first + windowSize - 1]);
+  });
+  return windows;
+}
+
+void Slicer::createFill(FillType fillType, int floorCount, int roofCount) {
+  if (fillType == NoFill)
+    return;
+
+  floorCount = std::clamp<int>(floorCount, 0, m_layerCount);
+  roofCount = std::clamp<int>(roofCount, 0, m_layerCount - floorCount);
+
+  // A layer is floor where it is not covered by all of the `floorCount`
+  // layers below it, and roof where it is not covered by all of the
+  // `roofCount` layers above it. Layers outside the model count as empty.
+  std::vector<Paths64> innermostShells(m_layerCount);
+  m_threadPool.parallelFor(m_layerCount, [&](size_t i) {
+    innermostShells[i] = m_slices[i].getInnermostShell();
+  });
+  std::vector<const Paths64 *> shells(m_layerCount);
+  for (size_t i = 0; i < m_layerCount; ++i)
+    shells[i] = &innermostShells[i];
+
+  const size_t floorWindow = std::max(floorCount, 1);
+  const size_t roofWindow = std::max(roofCount, 1);
+  const auto floorWindows = intersectWindows(shells, floorWindow, m_threadPool);
+  std::vector<Paths64> roofStorage;
+  if (roofWindow != floorWindow)
+    roofStorage = intersectWindows(shells, roofWindow, m_threadPool);
+  const auto &roofWindows =
+      roofWindow == floorWindow ? floorWindows : roofStorage;
+
+  const Paths64 none;
+  forEachLayer(Stage::Fill, [&](size_t i) {
+    const Paths64 &below =
+        i >= floorWindow ? floorWindows[i - floorWindow] : none;
+    const Paths64 &above =
+        i + 1 < roofWindows.size() ? roofWindows[i + 1] : none;
+    createLayerFill(i, fillType, floorCount, roofCount, innermostShells[i],
+                    below, above);
+  });
+  m_stageCounters.log(Stage::Fill);
+}
+
+void Slicer::createLayerFill(size_t i, FillType fillType, size_t floorCount,
+                             size_t roofCount, const Paths64 &shell,
+                             const Paths64 &below, const Paths64 &above) {
+  LayerScope scope(&m_stageCounters, Stage::Fill);
+  auto &workspace = Workspace::get();
+  auto &slice = m_slices[i];
+  const double angle = i % 2 == 0 ? 45.0 : 135.0;
+
+  // First `floorCount` and last `roofCount` layers are always filled
+  if (i < floorCount || i >= m_layerCount - roofCount) {
     Paths64 fill;
-    generateFill(fill, fillType, i % 2 == 0 ? 45.0 : 135.0);
-    slice.addFill(toPathsD(fill));
-    slice.setFillArea(toPathsD(m_currentArea));
+    generateFill(fill, shell, fillType, angle);
+    slice.addFill(fill);
+    slice.setFillArea(shell);
+    return;
   }
+
+  Paths64 floorArea =
+      workspace.clip(ClipType::Difference, FillRule::EvenOdd, shell, below);
+  Paths64 floor;
+  generateFill(floor, floorArea, fillType, angle);
+
+  Paths64 roofArea =
+      workspace.clip(ClipType::Difference, FillRule::EvenOdd, shell, above);
+  Paths64 roof;
+  generateFill(roof, roofArea, fillType, angle);
+
+  slice.addFill(floor);
+  slice.addFill(roof);
+
+  auto fillArea =
+      workspace.clip(ClipType::Union, FillRule::NonZero, floorArea, roofArea);
+  slice.setFillArea(fillArea);
 }
 
-void Slicer::generateFill(Paths64 &fillResult, FillType fillType,
-                          const double angle) {
+void Slicer::generateFill(Paths64 &fillResult, const Paths64 &area,
+                          FillType fillType, const double angle) const {
   switch (fillType) {
   case NoFill:
   case FillCount:
     return;
   case ConcentricFill:
-    generateConcentricInfill(fillResult, m_lineWidth);
+    generateConcentricInfill(fillResult, area, m_lineWidth);
     break;
   case LinesFill:
-    generateLineInfill(fillResult, m_lineWidth, angle, 0);
+    generateLineInfill(fillResult, area, m_lineWidth, angle, 0);
     break;
   }
 }
@@ -142,123 +772,167 @@ void Slicer::generateFill(Paths64 &fillResult, FillType fillType,
 void Slicer::createInfill(InfillType infillType, float density) {
   if (infillType == NoInfill)
     return;
-  for (m_currentLayer = 0; m_currentLayer < m_slices.size(); ++m_currentLayer) {
-    m_currentArea = toPaths64(
-        Difference(m_slices[m_currentLayer].getInnermostShell(),
-                   m_slices[m_currentLayer].getFillArea(), FillRule::NonZero));
-
-    Paths64 infill;
-    switch (infillType) {
-    case NoInfill:
-    case InfillCount:
-      return;
-    case LinesInfill:
-      generateLineInfill(infill, getLineDistance(1, density),
-                         m_currentLayer % 2 == 0 ? 45.0f : 135.0f, 0);
-      break;
-    case GridInfill:
-      generateGridInfill(infill, getLineDistance(2, density), 45.0);
-      break;
-    case Cubic:
-      generateCubicInfill(infill, getLineDistance(3, density), 45.0);
-      break;
-    case Triangle:
-      generateTriangleInfill(infill, getLineDistance(3, density), 45.0);
-      break;
-    case TriHexagon:
-      generateTriHexagonInfill(infill, getLineDistance(3, density), 45.0);
-      break;
-    case Tetrahedral:
-      generateTetrahedralInfill(infill, getLineDistance(2, density));
-      break;
-    case QuarterCubic:
-      generateQuarterCubicInfill(infill, getLineDistance(2, density));
-      break;
-    case ConcentricInfill:
-      generateConcentricInfill(infill, getLineDistance(1, density));
-      break;
-    }
-    m_slices[m_currentLayer].addInfill(toPathsD(infill));
+
+  // Layers only read their own walls and fill area
+  forEachLayer(Stage::Infill, [&](size_t layer) {
+    createLayerInfill(layer, infillType, density);
+  });
+  m_stageCounters.log(Stage::Infill);
+}
+
+void Slicer::createLayerInfill(size_t layer, InfillType infillType,
+                               float density) {
+  LayerScope scope(&m_stageCounters, Stage::Infill);
+  auto &slice = m_slices[layer];
+  const Paths64 area = Workspace::get().clip(
+      ClipType::Difference, FillRule::NonZero, slice.getInnermostShell(),
+      slice.getFillArea());
+
+  Paths64 infill;
+  switch (infillType) {
+  case NoInfill:
+  case InfillCount:
+    return;
+  case LinesInfill:
+    generateLineInfill(infill, area, getLineDistance(1, density),
+                       layer % 2 == 0 ? 45.0f : 135.0f, 0);
+    break;
+  case GridInfill:
+    generateGridInfill(infill, area, getLineDistance(2, density), 45.0);
+    break;
+  case Cubic:
+    generateCubicInfill(infill, area, layer, getLineDistance(3, density),
+                        45.0);
+    break;
+  case Triangle:
+    generateTriangleInfill(infill, area, getLineDistance(3, density), 45.0);
+    break;
+  case TriHexagon:
+    generateTriHexagonInfill(infill, area, getLineDistance(3, density),
+                             45.0);
+    break;
+  case Tetrahedral:
+    generateTetrahedralInfill(infill, area, layer,
+                              getLineDistance(2, density));
+    break;
+  case QuarterCubic:
+    generateQuarterCubicInfill(infill, area, layer,
+                               getLineDistance(2, density));
+    break;
+  case ConcentricInfill:
+    generateConcentricInfill(infill, area, getLineDistance(1, density));
+    break;
   }
+  slice.addInfill(infill);
 }
 
 void Slicer::createSupport(SupportType supportType, float density,
-                           size_t wallCount, size_t brimCount) {
+                           size_t wallCount, size_t brimCount,
+                           bool firstLayerSupport) {
   if (supportType == NoSupport)
     return;
-  m_slices.back().setSupportArea(PathsD());
-  for (auto it = m_slices.rbegin() + 1; it < m_slices.rend(); ++it) {
-    auto previousSliceIT = it - 1;
-
-    Paths64 prevPerimAndSupport = toPaths64(previousSliceIT->getPerimeter());
-    prevPerimAndSupport.append_range(
-        toPaths64(previousSliceIT->getSupportArea()));
-    prevPerimAndSupport = Union(prevPerimAndSupport, FillRule::EvenOdd);
-
-    auto dilatedPerimeter =
-        InflatePaths(toPaths64(it->getPerimeter()), m_lineWidth * 2.0f,
-                     JoinType::Miter, EndType::Polygon);
-
-    auto supportArea =
-        Difference(prevPerimAndSupport, dilatedPerimeter, FillRule::EvenOdd);
-    it->setSupportArea(toPathsD(supportArea));
-
-    // Remove support from the last layer before a floor
-    auto lastLayerSupport =
-        Difference(toPaths64(previousSliceIT->getPerimeter()),
-                   toPaths64(it->getPerimeter()), FillRule::EvenOdd);
-    supportArea = Difference(supportArea, lastLayerSupport, FillRule::EvenOdd);
-
-    // Horizontal expansion of the support
-    supportArea = InflatePaths(supportArea, 2.0 * m_lineWidth, JoinType::Round,
-                               EndType::Polygon);
-    supportArea = Difference(supportArea, dilatedPerimeter, FillRule::EvenOdd);
-
-    m_currentArea = supportArea;
-
-    Paths64 support;
-    for (size_t i = 0; i < (it != m_slices.rend() - 1 ? wallCount : brimCount);
-         ++i) {
-      m_currentArea =
-          InflatePaths(supportArea, -static_cast<double>(m_lineWidth) * i,
-                       JoinType::Round, EndType::Polygon);
-      support.append_range(closePaths(m_currentArea));
-    }
-    Paths64 supportLines;
-    switch (supportType) {
-    case NoSupport:
-    case SupportCount:
+  // Every layer grows the support of the one above it
+  m_slices.back().setSupportArea(Paths64());
+  for (size_t i = m_slices.size() - 1; i-- > 0;) {
+    if (!beginLayer())
       return;
-    case LinesSupport:
-      generateLineInfill(supportLines, m_lineWidth / density, 0.0, 0.0);
-      break;
-    case GridSupport:
-      generateGridInfill(supportLines, (2.0 * m_lineWidth) / density, 0.0);
-      break;
-    case Triangles:
-      generateTriangleInfill(supportLines, (3.0 * m_lineWidth) / density, 0.0);
-      break;
-    case ConcentricSupport:
-      generateConcentricInfill(supportLines, m_lineWidth / density);
-      break;
-    }
+    createLayerSupport(i, supportType, density, wallCount, brimCount,
+                       firstLayerSupport);
+    publishLayer(i, Stage::Support);
+  }
+  m_stageCounters.log(Stage::Support);
+}
+
+void Slicer::createLayerSupport(size_t i, SupportType supportType,
+                                float density, size_t wallCount,
+                                size_t brimCount, bool firstLayerSupport) {
+  LayerScope scope(&m_stageCounters, Stage::Support);
+  auto &workspace = Workspace::get();
+  auto &slice = m_slices[i];
+  const auto &previousSlice = m_slices[i + 1];
+
+  Paths64 prevPerimAndSupport = previousSlice.getPerimeter();
+  prevPerimAndSupport.append_range(previousSlice.getSupportArea());
+  prevPerimAndSupport = workspace.clip(ClipType::Union, FillRule::EvenOdd,
+                                       prevPerimAndSupport, Paths64());
+
+  auto dilatedPerimeter =
+      workspace.inflate(slice.getPerimeter(), m_lineWidth * 2.0f,
+                        JoinType::Miter, EndType::Polygon);
+
+  auto supportArea =
+      workspace.clip(ClipType::Difference, FillRule::EvenOdd,
+                     prevPerimAndSupport, dilatedPerimeter);
+  slice.setSupportArea(supportArea);
+
+  // Remove support from the last layer before a floor
+  auto lastLayerSupport =
+      workspace.clip(ClipType::Difference, FillRule::EvenOdd,
+                     previousSlice.getPerimeter(), slice.getPerimeter());
+  supportArea = workspace.clip(ClipType::Difference, FillRule::EvenOdd,
+                               supportArea, lastLayerSupport);
+
+  // Horizontal expansion of the support
+  supportArea = workspace.inflate(supportArea, 2.0 * m_lineWidth,
+                                  JoinType::Round, EndType::Polygon);
+  supportArea = workspace.clip(ClipType::Difference, FillRule::EvenOdd,
+                               supportArea, dilatedPerimeter);
 
-    Clipper64 clipper;
-    clipper.AddClip(supportArea);
-    clipper.AddOpenSubject(supportLines);
-    Paths64 discard;
-    clipper.Execute(ClipType::Intersection, FillRule::EvenOdd, discard,
-                    supportLines);
+  // The pattern fills the innermost support wall. The walls share one
+  // offset of the support area.
+  Paths64 patternArea = supportArea;
 
-    support.append_range(supportLines);
-    it->addSupport(toPathsD(support));
+  Paths64 support;
+  workspace.offset.Clear();
+  workspace.offset.AddPaths(supportArea, JoinType::Round, EndType::Polygon);
+  for (size_t wall = 0; wall < (i != 0 ? wallCount : brimCount); ++wall) {
+    workspace.offset.Execute(-static_cast<double>(m_lineWidth) * wall,
+                             patternArea);
+    support.append_range(closePaths(patternArea));
   }
+  Paths64 supportLines;
+  switch (supportType) {
+  case NoSupport:
+  case SupportCount:
+    return;
+  case LinesSupport:
+    generateLineInfill(supportLines, patternArea, m_lineWidth / density, 0.0,
+                       0.0);
+    break;
+  case GridSupport:
+    generateGridInfill(supportLines, patternArea,
+                       (2.0 * m_lineWidth) / density, 0.0);
+    break;
+  case Triangles:
+    generateTriangleInfill(supportLines, patternArea,
+                           (3.0 * m_lineWidth) / density, 0.0);
+    break;
+  case ConcentricSupport:
+    generateConcentricInfill(supportLines, patternArea,
+                             m_lineWidth / density);
+    break;
+  }
+
+  // The generators already clip to patternArea, an inward offset of
+  // supportArea, so only the Clipper path clips the lines a second time
+#ifdef SLICER_CLIPPER_LINES
+  auto &clipper = workspace.clipper;
+  clipper.Clear();
+  clipper.AddClip(supportArea);
+  clipper.AddOpenSubject(supportLines);
+  Paths64 discard;
+  clipper.Execute(ClipType::Intersection, FillRule::EvenOdd, discard,
+                  supportLines);
+#endif
+
+  support.append_range(supportLines);
+  if (firstLayerSupport || i != 0)
+    slice.addSupport(support);
 }
 
 void Slicer::createBrim(BrimLocation brimLocation, int lineCount) {
   auto &slice = m_slices.front();
-  const Paths64 &perimeter = toPaths64(slice.getPerimeter());
-  slice.removeSupport();
+  const Paths64 &perimeter = slice.getPerimeter();
 
   for (int i = 1; i <= lineCount; ++i) {
 
@@ -279,7 +953,7 @@ void Slicer::createBrim(BrimLocation brimLocation, int lineCount) {
                              });
     brim.erase(it, brim.end());
 
-    slice.addSupport(toPathsD(closePaths(brim)));
+    slice.addAdhesion(closePaths(brim));
   }
 }
 
@@ -290,21 +964,23 @@ void Slicer::createSkirt(int lineCount, int height, float distance) {
   // First layer gets `lineCount` lines
   auto &slice = m_slices.front();
   auto perimeter = slice.getPerimeter();
-  PathsD area = perimeter;
-  for (auto &support : slice.getSupport())
-    area = Union(perimeter, support, FillRule::NonZero);
+  Paths64 area = perimeter;
+  const auto &support = slice.getSupport();
+  for (size_t group = 0; group < support.getGroupCount(); ++group)
+    area = Union(perimeter, support.getGroup(group), FillRule::NonZero);
 
-  auto skirt = InflatePaths(area, distance, JoinType::Round, EndType::Polygon);
+  auto skirt = InflatePaths(area, MM2INT(distance), JoinType::Round,
+                            EndType::Polygon);
 
   for (int i = 0; i < lineCount; ++i) {
-    slice.addSupport(closePaths(InflatePaths(
-        skirt, INT2MM(i * m_lineWidth), JoinType::Round, EndType::Polygon)));
+    slice.addAdhesion(closePaths(InflatePaths(
+        skirt, i * m_lineWidth, JoinType::Round, EndType::Polygon)));
   }
 
   // `height` - 1 layers get the first skirt aswell
   for (auto sliceIt = m_slices.begin() + 1; sliceIt < m_slices.begin() + height;
        ++sliceIt) {
-    sliceIt->addSupport(closePaths(skirt));
+    sliceIt->addAdhesion(closePaths(skirt));
   }
 }
 
@@ -312,122 +988,156 @@ int64_t Slicer::getLineDistance(uint lineCount, float density) const {
   return MM2INT(INT2MM(m_lineWidth * lineCount) / density);
 }
 
-int64_t Slicer::getShiftOffsetFromInfillOriginAndRotation(const Paths64 &area,
-                                                          const double angle) {
-  Rect64 bounds = GetBounds(area);
-  Point64 origin = bounds.MidPoint();
-  if (origin.x != 0 || origin.y != 0) {
-    return origin.x * std::cos(glm::radians(angle)) -
-           origin.y * std::sin(glm::radians(angle));
-  }
-  return 0;
-}
-
-void Slicer::generateLineInfill(Paths64 &infillResult,
+void Slicer::generateLineInfill(Paths64 &infillResult, const Paths64 &area,
                                 const int64_t lineDistance, const double angle,
-                                int64_t shift) {
-  if (lineDistance == 0 || m_currentArea.empty())
+                                int64_t shift) const {
+  if (lineDistance == 0 || area.empty())
     return;
 
-  Paths64 outline = m_currentArea;
-
-  rotatePaths(outline, angle);
-
-  const int64_t origShift = shift;
-  const int64_t rotShift =
-      getShiftOffsetFromInfillOriginAndRotation(m_currentArea, angle);
-  shift += rotShift + m_shift + extraShift;
-  if (shift < 0) {
-    shift = lineDistance - (-shift) % lineDistance;
-  } else {
-    shift = shift % lineDistance;
-  }
-
-  auto [minX, minY, maxX, maxY] = GetBounds(outline);
+  const int64_t phase = shift + m_shift + m_extraShift;
+#ifdef SLICER_CLIPPER_LINES
+  const Rect64 bounds = GetBounds(area);
+  const auto pattern =
+      m_patternCache.getLines(bounds, angle, lineDistance, phase);
+  const auto [first, last] = pattern->getRange(bounds);
+  if (first == last)
+    return;
 
+  auto &clipper = Workspace::get().clipper;
+  clipper.Clear();
+  clipper.AddOpenSubject(Paths64(pattern->lines.begin() + first,
+                                 pattern->lines.begin() + last));
+  clipper.AddClip(area);
   Paths64 lines;
-  int64_t y = minY - shift;
-  while (y < maxY + shift) {
-    lines.push_back({{minX, y}, {maxX, y}});
-    y += lineDistance;
-  }
-  unRotatePaths(lines, angle);
-
-  Clipper64 clipper;
-  clipper.AddOpenSubject(lines);
-  clipper.AddClip(m_currentArea);
   Paths64 discard;
   clipper.Execute(ClipType::Intersection, FillRule::NonZero, discard, lines);
   infillResult.append_range(lines);
+#else
+  // The kernel finds the lines crossing the area itself, no pattern needed
+  clipLines(infillResult, area, FillRule::NonZero, angle,
+            m_patternCache.getOffset(angle, phase), lineDistance);
+#endif
 }
 
-void Slicer::generateGridInfill(Paths64 &infillResult,
+void Slicer::generateGridInfill(Paths64 &infillResult, const Paths64 &area,
                                 const int64_t lineDistance,
-                                const double angle) {
-  generateLineInfill(infillResult, lineDistance, 0, 0);
-  generateLineInfill(infillResult, lineDistance, 90, -1000);
+                                const double angle) const {
+  generateLineInfill(infillResult, area, lineDistance, 0, 0);
+  generateLineInfill(infillResult, area, lineDistance, 90, -1000);
+}
+
+// Cubic and tetrahedral patterns move a little on every layer. When the
+// lines are clipped by Clipper, each shift needs its own cached pattern, so
+// the shift is snapped to one of PHASE_STEPS positions per period; the error
+// is at most half a step. The scanline path takes any shift as is.
+#ifdef SLICER_CLIPPER_LINES
+static constexpr int64_t PHASE_STEPS = 64;
+#endif
+
+static int64_t snapPhase(int64_t shift, int64_t period) {
+#ifdef SLICER_CLIPPER_LINES
+  if (period <= 0)
+    return shift;
+  const int64_t phase = (shift % period + period) % period;
+  const int64_t step = (phase * PHASE_STEPS + period / 2) / period;
+  return step * period / PHASE_STEPS;
+#else
+  return shift;
+#endif
 }
 
-void Slicer::generateCubicInfill(Paths64 &infillResult,
-                                 const int64_t lineDistance,
-                                 const double angle) {
-  const int64_t shift =
-      (m_currentLayer * MM2INT(m_layerHeight)) / std::numbers::sqrt2;
-  generateLineInfill(infillResult, lineDistance, angle + 0, shift);
-  generateLineInfill(infillResult, lineDistance, angle + 120, shift);
-  generateLineInfill(infillResult, lineDistance, angle + 240, shift);
+void Slicer::generateCubicInfill(Paths64 &infillResult, const Paths64 &area,
+                                 size_t layer, const int64_t lineDistance,
+                                 const double angle) const {
+  const int64_t shift = snapPhase(
+      (layer * MM2INT(m_layerHeight)) / std::numbers::sqrt2, lineDistance);
+  generateLineInfill(infillResult, area, lineDistance, angle + 0, shift);
+  generateLineInfill(infillResult, area, lineDistance, angle + 120, shift);
+  generateLineInfill(infillResult, area, lineDistance, angle + 240, shift);
 }
 
-void Slicer::generateTriangleInfill(Paths64 &infillResult,
+void Slicer::generateTriangleInfill(Paths64 &infillResult, const Paths64 &area,
                                     const int64_t lineDistance,
-                                    const double angle) {
-  generateLineInfill(infillResult, lineDistance, angle, 0);
-  generateLineInfill(infillResult, lineDistance, angle + 60, 0);
-  generateLineInfill(infillResult, lineDistance, angle + 120, 0);
+                                    const double angle) const {
+  generateLineInfill(infillResult, area, lineDistance, angle, 0);
+  generateLineInfill(infillResult, area, lineDistance, angle + 60, 0);
+  generateLineInfill(infillResult, area, lineDistance, angle + 120, 0);
 }
 void Slicer::generateTriHexagonInfill(Paths64 &infillResult,
+                                      const Paths64 &area,
                                       const int64_t lineDistance,
-                                      const double angle) {
-  generateLineInfill(infillResult, lineDistance, angle, 0);
-  generateLineInfill(infillResult, lineDistance, angle + 60, 0);
-  generateLineInfill(infillResult, lineDistance, angle + 120,
+                                      const double angle) const {
+  generateLineInfill(infillResult, area, lineDistance, angle, 0);
+  generateLineInfill(infillResult, area, lineDistance, angle + 60, 0);
+  generateLineInfill(infillResult, area, lineDistance, angle + 120,
                      lineDistance / 2.0f);
 }
 
 void Slicer::generateTetrahedralInfill(Paths64 &infillResult,
-                                       const int64_t lineDistance) {
-  generateHalfTetrahedralInfill(infillResult, lineDistance, 0, 0.0);
-  generateHalfTetrahedralInfill(infillResult, lineDistance, 90, 0.0);
+                                       const Paths64 &area, size_t layer,
+                                       const int64_t lineDistance) const {
+  generateHalfTetrahedralInfill(infillResult, area, layer, lineDistance, 0,
+                                0.0);
+  generateHalfTetrahedralInfill(infillResult, area, layer, lineDistance, 90,
+                                0.0);
 }
 void Slicer::generateQuarterCubicInfill(Paths64 &infillResult,
-                                        const int64_t lineDistance) {
-  generateHalfTetrahedralInfill(infillResult, lineDistance, 0, 0.0);
-  generateHalfTetrahedralInfill(infillResult, lineDistance, 90, 0.5);
+                                        const Paths64 &area, size_t layer,
+                                        const int64_t lineDistance) const {
+  generateHalfTetrahedralInfill(infillResult, area, layer, lineDistance, 0,
+                                0.0);
+  generateHalfTetrahedralInfill(infillResult, area, layer, lineDistance, 90,
+                                0.5);
 }
 
 void Slicer::generateHalfTetrahedralInfill(Paths64 &infillResult,
+                                           const Paths64 &area, size_t layer,
                                            const int64_t lineDistance,
-                                           const double angle, double zShift) {
+                                           const double angle,
+                                           double zShift) const {
   int64_t period = lineDistance * 2;
-  int64_t shift = m_currentLayer * MM2INT(m_layerHeight) + zShift * period * 2;
+  int64_t shift = layer * MM2INT(m_layerHeight) + zShift * period * 2;
   shift /= std::numbers::sqrt2;
   shift %= period;
   shift = std::min(shift, period - shift);
+  // Snap before clamping, so the lines never come closer than a line width
+  shift = snapPhase(shift, period);
   shift = std::min(shift, period / 2 - m_lineWidth / 2);
   shift = std::max(shift, m_lineWidth / 2);
-  generateLineInfill(infillResult, period, 45.0 + angle, shift);
-  generateLineInfill(infillResult, period, 45.0 + angle, -shift);
+  generateLineInfill(infillResult, area, period, 45.0 + angle, shift);
+  generateLineInfill(infillResult, area, period, 45.0 + angle, -shift);
 }
 
 void Slicer::generateConcentricInfill(Paths64 &infillResult,
-                                      const int64_t lineDistance) {
-  std::vector<Paths64> fills{closePaths(InflatePaths(
-      m_currentArea, -lineDistance, JoinType::Round, EndType::Polygon))};
-  while (fills.back().size() > 0) {
-    fills.push_back(closePaths(InflatePaths(
-        fills.back(), -lineDistance, JoinType::Round, EndType::Polygon)));
-  }
+                                      const Paths64 &area,
+                                      const int64_t lineDistance) const {
+  if (lineDistance <= 0 || area.empty())
+    return;
+
+  // Ring k is offset from the area itself instead of from ring k - 1, so the
+  // rings are independent and rounding errors do not add up. No ring fits
+  // deeper than half the smaller side of the bounds.
+  const Rect64 bounds = GetBounds(area);
+  const size_t maxRings = static_cast<size_t>(
+      std::min(bounds.Width(), bounds.Height()) / 2 / lineDistance + 1);
+
+  // Rings only shrink, so every ring past an empty one is skipped
+  std::vector<Paths64> rings(maxRings);
+  std::atomic<size_t> firstEmpty = maxRings;
+  m_threadPool.parallelFor(maxRings, [&](size_t k) {
+    if (k > firstEmpty.load(std::memory_order_relaxed))
+      return;
+
+    const double delta = -static_cast<double>(lineDistance) * (k + 1);
+    rings[k] = closePaths(Workspace::get().inflate(area, delta, JoinType::Round,
+                                                   EndType::Polygon));
+    if (rings[k].empty()) {
+      size_t current = firstEmpty.load(std::memory_order_relaxed);
+      while (k < current && !firstEmpty.compare_exchange_weak(current, k))
+        ;
+    }
+  });
 
-  for (auto &paths : fills)
-    infillResult.append_range(paths);
+  for (auto &ring : rings)
+    infillResult.append_range(ring);
 }
\ No newline at end of file
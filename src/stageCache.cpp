@@ -0,0 +1,397 @@
+#include "stageCache.h"
+
+#include <Nexus.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unistd.h>
+
+using namespace Clipper2Lib;
+namespace fs = std::filesystem;
+
+static constexpr uint32_t MAGIC = 0x43434c53; // "SLCC"
+static constexpr uint32_t VERSION = 1;
+static constexpr const char *EXTENSION = ".slc";
+// Entries are written under a temporary name first. Files left behind by a
+// process that died while writing are deleted once they are this old.
+static constexpr const char *TEMPORARY_SUFFIX = ".tmp";
+static constexpr auto ABANDONED_AGE = std::chrono::hours(1);
+
+namespace {
+
+// What a stage adds to every slice: whole path types plus at most one area
+struct StageLayout {
+  std::span<const Slice::PathType> paths;
+  enum { NoArea, Contour, FillArea, SupportArea } area;
+};
+
+StageLayout getLayout(Stage stage) {
+  const auto paths = Slice::getStagePathTypes(stage);
+  switch (stage) {
+  case Stage::Slices:
+    return {paths, StageLayout::Contour};
+  case Stage::Fill:
+    return {paths, StageLayout::FillArea};
+  case Stage::Support:
+    return {paths, StageLayout::SupportArea};
+  default:
+    return {paths, StageLayout::NoArea};
+  }
+}
+
+class Writer {
+public:
+  template <typename T> void write(T value) {
+    const auto *bytes = reinterpret_cast<const char *>(&value);
+    m_data.insert(m_data.end(), bytes, bytes + sizeof(value));
+  }
+
+  void writePath(PathBuffer::PathView path) {
+    write<uint64_t>(path.size());
+    for (const auto &point : path) {
+      write<int64_t>(point.x);
+      write<int64_t>(point.y);
+    }
+  }
+
+  void writePaths(const Paths64 &paths) {
+    write<uint64_t>(paths.size());
+    for (const auto &path : paths)
+      writePath(path);
+  }
+
+  void writeBuffer(const PathBuffer &buffer) {
+    write<uint64_t>(buffer.getGroupCount());
+    for (size_t group = 0; group < buffer.getGroupCount(); ++group) {
+      const auto [first, last] = buffer.getGroupRange(group);
+      write<uint64_t>(last - first);
+      for (size_t i = first; i < last; ++i)
+        writePath(buffer.getPath(i));
+    }
+  }
+
+  const std::vector<char> &getData() const { return m_data; }
+
+private:
+  std::vector<char> m_data;
+};
+
+// Reads from a loaded entry. Every read is bounds checked, a truncated or
+// corrupted file fails instead of producing garbage.
+class Reader {
+public:
+  explicit Reader(const std::vector<char> &data) : m_data(data) {}
+
+  template <typename T> bool read(T &value) {
+    if (m_data.size() - m_offset < sizeof(value))
+      return false;
+    std::memcpy(&value, m_data.data() + m_offset, sizeof(value));
+    m_offset += sizeof(value);
+    return true;
+  }
+
+  bool readPaths(Paths64 &paths) {
+    uint64_t pathCount;
+    if (!readCount(pathCount, sizeof(uint64_t)))
+      return false;
+    paths.resize(pathCount);
+    for (auto &path : paths) {
+      uint64_t pointCount;
+      if (!readCount(pointCount, 2 * sizeof(int64_t)))
+        return false;
+      path.resize(pointCount);
+      for (auto &point : path) {
+        int64_t x, y;
+        read(x);
+        read(y);
+        point = Point64(x, y);
+      }
+    }
+    return true;
+  }
+
+  bool readGroups(std::vector<Paths64> &groups) {
+    uint64_t groupCount;
+    if (!readCount(groupCount, sizeof(uint64_t)))
+      return false;
+    groups.resize(groupCount);
+    for (auto &group : groups)
+      if (!readPaths(group))
+        return false;
+    return true;
+  }
+
+  bool isDone() const { return m_offset == m_data.size(); }
+
+private:
+  // Reads an element count and checks that many elements of at least
+  // `elementSize` bytes can follow
+  bool readCount(uint64_t &count, size_t elementSize) {
+    return read(count) && count <= (m_data.size() - m_offset) / elementSize;
+  }
+
+  const std::vector<char> &m_data;
+  size_t m_offset = 0;
+};
+
+struct LayerData {
+  std::vector<std::vector<Paths64>> paths;
+  Paths64 area;
+};
+
+} // namespace
+
+void StageCache::setDirectory(fs::path directory, uint64_t maxBytes) {
+  m_directory = std::move(directory);
+  m_maxBytes = maxBytes;
+  if (m_directory.empty())
+    return;
+
+  std::error_code error;
+  fs::create_directories(m_directory, error);
+  if (error) {
+    Nexus::Logger::warn("Disabling the stage cache, cannot create {}: {}",
+                        m_directory.string(), error.message());
+    m_directory.clear();
+    return;
+  }
+  evict();
+}
+
+fs::path StageCache::getDefaultDirectory() {
+  if (const char *cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+    return fs::path(cache) / "slicer";
+  if (const char *home = std::getenv("HOME"); home && *home)
+    return fs::path(home) / ".cache" / "slicer";
+  return {};
+}
+
+fs::path StageCache::getPath(Stage stage, uint64_t key) const {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%s-%016llx%s", getStageName(stage),
+                static_cast<unsigned long long>(key), EXTENSION);
+  return m_directory / name;
+}
+
+bool StageCache::load(Stage stage, uint64_t key, std::vector<Slice> &slices) {
+  if (!isEnabled())
+    return false;
+
+  const fs::path path = getPath(stage, key);
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    ++m_stats.misses;
+    return false;
+  }
+  std::vector<char> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+  if (!file) {
+    ++m_stats.misses;
+    return false;
+  }
+
+  // Parse everything before touching the slices
+  Reader reader(data);
+  uint32_t magic, version, stageId;
+  uint64_t storedKey, layerCount;
+  const bool validHeader =
+      reader.read(magic) && reader.read(version) && reader.read(stageId) &&
+      reader.read(storedKey) && reader.read(layerCount) && magic == MAGIC &&
+      version == VERSION && stageId == static_cast<uint32_t>(stage) &&
+      storedKey == key && layerCount == slices.size();
+
+  const StageLayout layout = getLayout(stage);
+  std::vector<LayerData> layers(validHeader ? layerCount : 0);
+  bool valid = validHeader;
+  for (auto &layer : layers) {
+    layer.paths.resize(layout.paths.size());
+    for (auto &groups : layer.paths)
+      valid = valid && reader.readGroups(groups);
+    if (layout.area != StageLayout::NoArea)
+      valid = valid && reader.readPaths(layer.area);
+    if (!valid)
+      break;
+  }
+
+  if (!valid || !reader.isDone()) {
+    Nexus::Logger::warn("Deleting corrupted stage cache entry {}",
+                        path.string());
+    remove(path);
+    ++m_stats.misses;
+    return false;
+  }
+
+  for (size_t i = 0; i < slices.size(); ++i) {
+    auto &slice = slices[i];
+    auto &layer = layers[i];
+    slice.clearStage(stage);
+    for (size_t type = 0; type < layout.paths.size(); ++type)
+      for (const auto &group : layer.paths[type])
+        slice.addPaths(layout.paths[type], group);
+
+    switch (layout.area) {
+    case StageLayout::Contour:
+      slice.setContour(std::move(layer.area));
+      break;
+    case StageLayout::FillArea:
+      slice.setFillArea(std::move(layer.area));
+      break;
+    case StageLayout::SupportArea:
+      slice.setSupportArea(std::move(layer.area));
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Loading counts as a use for the eviction order
+  std::error_code error;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+
+  ++m_stats.hits;
+  m_stats.bytesRead += data.size();
+  return true;
+}
+
+void StageCache::store(Stage stage, uint64_t key,
+                       const std::vector<Slice> &slices) {
+  if (!isEnabled())
+    return;
+
+  Writer writer;
+  writer.write(MAGIC);
+  writer.write(VERSION);
+  writer.write(static_cast<uint32_t>(stage));
+  writer.write(key);
+  writer.write<uint64_t>(slices.size());
+
+  const StageLayout layout = getLayout(stage);
+  for (const auto &slice : slices) {
+    for (const auto type : layout.paths)
+      writer.writeBuffer(slice.getPaths(type));
+
+    switch (layout.area) {
+    case StageLayout::Contour:
+      writer.writePaths(slice.getContour());
+      break;
+    case StageLayout::FillArea:
+      writer.writePaths(slice.getFillArea());
+      break;
+    case StageLayout::SupportArea:
+      writer.writePaths(slice.getSupportArea());
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Written next to the entry and renamed, so other processes never read a
+  // partial file. Every write gets its own name, jobs in one process may
+  // store the same entry at once.
+  static std::atomic<uint64_t> writeCount{0};
+  const fs::path path = getPath(stage, key);
+  fs::path temporary = path;
+  temporary += TEMPORARY_SUFFIX + std::to_string(getpid()) + "-" +
+               std::to_string(writeCount.fetch_add(1));
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(writer.getData().data(), writer.getData().size());
+    if (!file) {
+      Nexus::Logger::warn("Could not write stage cache entry {}",
+                          temporary.string());
+      std::error_code error;
+      fs::remove(temporary, error);
+      return;
+    }
+  }
+
+  // An entry being replaced no longer counts towards the size
+  std::error_code error;
+  const uint64_t replacedSize = fs::file_size(path, error);
+  if (!error)
+    m_totalBytes -= std::min(m_totalBytes, replacedSize);
+
+  fs::rename(temporary, path, error);
+  if (error) {
+    Nexus::Logger::warn("Could not write stage cache entry {}: {}",
+                        path.string(), error.message());
+    fs::remove(temporary, error);
+    return;
+  }
+
+  m_stats.bytesWritten += writer.getData().size();
+  m_totalBytes += writer.getData().size();
+  if (m_totalBytes > m_maxBytes)
+    evict();
+}
+
+void StageCache::remove(const fs::path &path) {
+  std::error_code error;
+  const uint64_t size = fs::file_size(path, error);
+  if (!error && fs::remove(path, error))
+    m_totalBytes -= std::min(m_totalBytes, size);
+}
+
+void StageCache::evict() {
+  struct Entry {
+    fs::file_time_type lastUse;
+    uint64_t size;
+    fs::path path;
+  };
+  std::vector<Entry> entries;
+  uint64_t totalSize = 0;
+
+  // Other processes may have added entries since the last scan
+  const auto abandoned = fs::file_time_type::clock::now() - ABANDONED_AGE;
+  std::error_code error;
+  for (const auto &file : fs::directory_iterator(m_directory, error)) {
+    std::error_code fileError;
+    const uint64_t size = file.file_size(fileError);
+    const auto lastUse = file.last_write_time(fileError);
+    if (fileError)
+      continue;
+
+    const std::string name = file.path().filename().string();
+    if (name.find(std::string(EXTENSION) + TEMPORARY_SUFFIX) !=
+        std::string::npos) {
+      if (lastUse < abandoned)
+        fs::remove(file.path(), fileError);
+      continue;
+    }
+    if (file.path().extension() != EXTENSION)
+      continue;
+    entries.push_back({lastUse, size, file.path()});
+    totalSize += size;
+  }
+  m_totalBytes = totalSize;
+  if (totalSize <= m_maxBytes)
+    return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.lastUse < b.lastUse;
+            });
+  for (const auto &entry : entries) {
+    if (totalSize <= m_maxBytes)
+      break;
+    if (fs::remove(entry.path, error)) {
+      totalSize -= entry.size;
+      ++m_stats.evictions;
+    }
+  }
+  m_totalBytes = totalSize;
+}
+
+void StageCache::logStats() const {
+  Nexus::Logger::debug("Stage cache: {} hits, {} misses, {} KB read, {} KB "
+                       "written, {} evictions",
+                       m_stats.hits, m_stats.misses, m_stats.bytesRead / 1024,
+                       m_stats.bytesWritten / 1024, m_stats.evictions);
+}
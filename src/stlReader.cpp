@@ -0,0 +1,162 @@
+#include "stlReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+static constexpr size_t HEADER_SIZE = 80;
+static constexpr size_t RECORD_SIZE = 50;
+static constexpr size_t FACET_FLOATS = 12;
+
+static bool isBinaryStl(const char *data, size_t length) {
+  if (length < HEADER_SIZE + sizeof(uint32_t))
+    return false;
+
+  uint32_t facetCount;
+  std::memcpy(&facetCount, data + HEADER_SIZE, sizeof(uint32_t));
+  return HEADER_SIZE + sizeof(uint32_t) +
+             RECORD_SIZE * static_cast<uint64_t>(facetCount) ==
+         length;
+}
+
+static bool isAsciiStl(const char *data, size_t length) {
+  const std::string_view text(data, length);
+  const size_t start = text.find_first_not_of(" \t\r\n");
+  return start != std::string_view::npos && text.substr(start, 5) == "solid";
+}
+
+bool isStl(const char *data, size_t length) {
+  return isBinaryStl(data, length) || isAsciiStl(data, length);
+}
+
+// Writes the three corners of a facet given in file axes
+static void storeFacet(const float *corners, glm::vec3 *positions,
+                       glm::vec3 &min, glm::vec3 &max) {
+  for (int i = 0; i < 3; ++i) {
+    const float *corner = corners + 3 * i;
+    positions[i] = glm::vec3(corner[0], corner[2], corner[1]);
+    min = glm::min(min, positions[i]);
+    max = glm::max(max, positions[i]);
+  }
+}
+
+static size_t getChunkCount(ThreadPool &threadPool, size_t facetCount) {
+  return std::min(threadPool.getWorkerCount(), facetCount);
+}
+
+static void readBinaryStl(const char *data, ThreadPool &threadPool,
+                          StlMesh &mesh) {
+  uint32_t facetCount;
+  std::memcpy(&facetCount, data + HEADER_SIZE, sizeof(uint32_t));
+  const char *records = data + HEADER_SIZE + sizeof(uint32_t);
+
+  mesh.positions.resize(static_cast<size_t>(facetCount) * 3);
+
+  const size_t chunkCount = getChunkCount(threadPool, facetCount);
+  std::vector<glm::vec3> chunkMin(chunkCount, mesh.min);
+  std::vector<glm::vec3> chunkMax(chunkCount, mesh.max);
+  threadPool.parallelFor(chunkCount, [&](size_t chunk) {
+    const size_t begin = facetCount * chunk / chunkCount;
+    const size_t end = facetCount * (chunk + 1) / chunkCount;
+    for (size_t i = begin; i < end; ++i) {
+      // Records are 50 bytes long, so the floats are not aligned
+      float facet[FACET_FLOATS];
+      std::memcpy(facet, records + i * RECORD_SIZE, sizeof(facet));
+      storeFacet(facet + 3, &mesh.positions[i * 3], chunkMin[chunk],
+                 chunkMax[chunk]);
+    }
+  });
+
+  for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+    mesh.min = glm::min(mesh.min, chunkMin[chunk]);
+    mesh.max = glm::max(mesh.max, chunkMax[chunk]);
+  }
+}
+
+static std::string_view nextToken(const char *&cursor, const char *end) {
+  while (cursor < end && std::isspace(static_cast<unsigned char>(*cursor)))
+    ++cursor;
+  const char *start = cursor;
+  while (cursor < end && !std::isspace(static_cast<unsigned char>(*cursor)))
+    ++cursor;
+  return {start, static_cast<size_t>(cursor - start)};
+}
+
+static bool parseFloats(const char *&cursor, const char *end, float *values,
+                        int count) {
+  for (int i = 0; i < count; ++i) {
+    std::string_view token = nextToken(cursor, end);
+    if (!token.empty() && token.front() == '+')
+      token.remove_prefix(1);
+
+    const char *tokenEnd = token.data() + token.size();
+    auto [last, error] = std::from_chars(token.data(), tokenEnd, values[i]);
+    if (error != std::errc() || last != tokenEnd)
+      return false;
+  }
+  return true;
+}
+
+static bool readAsciiStl(const char *data, size_t length, StlMesh &mesh) {
+  const char *cursor = data;
+  const char *end = data + length;
+
+  float facet[FACET_FLOATS];
+  // Number of corners read for the current facet, -1 outside of a facet
+  int cornerCount = -1;
+
+  for (auto token = nextToken(cursor, end); !token.empty();
+       token = nextToken(cursor, end)) {
+    if (token == "facet") {
+      if (cornerCount != -1 || nextToken(cursor, end) != "normal" ||
+          !parseFloats(cursor, end, facet, 3))
+        return false;
+      cornerCount = 0;
+    } else if (token == "vertex") {
+      if (cornerCount < 0 || cornerCount == 3 ||
+          !parseFloats(cursor, end, facet + 3 + 3 * cornerCount, 3))
+        return false;
+      ++cornerCount;
+    } else if (token == "endfacet") {
+      if (cornerCount != 3)
+        return false;
+      mesh.positions.resize(mesh.positions.size() + 3);
+      storeFacet(facet + 3, &mesh.positions[mesh.positions.size() - 3],
+                 mesh.min, mesh.max);
+      cornerCount = -1;
+    }
+  }
+
+  return cornerCount == -1;
+}
+
+bool readStl(const char *data, size_t length, ThreadPool &threadPool,
+             StlMesh &mesh) {
+  mesh.positions.clear();
+  mesh.min = glm::vec3(std::numeric_limits<float>::max());
+  mesh.max = glm::vec3(-std::numeric_limits<float>::max());
+
+  if (isBinaryStl(data, length))
+    readBinaryStl(data, threadPool, mesh);
+  else if (!isAsciiStl(data, length) || !readAsciiStl(data, length, mesh))
+    return false;
+
+  const size_t facetCount = mesh.positions.size() / 3;
+  if (facetCount == 0)
+    return false;
+
+  const glm::vec3 center = (mesh.max + mesh.min) / 2.0f;
+  const size_t chunkCount = getChunkCount(threadPool, facetCount);
+  threadPool.parallelFor(chunkCount, [&](size_t chunk) {
+    const size_t begin = 3 * (facetCount * chunk / chunkCount);
+    const size_t end = 3 * (facetCount * (chunk + 1) / chunkCount);
+    for (size_t i = begin; i < end; ++i)
+      mesh.positions[i] -= center;
+  });
+
+  return true;
+}
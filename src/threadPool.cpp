@@ -0,0 +1,91 @@
+#include "threadPool.h"
+
+#include <algorithm>
+
+static thread_local bool insideTask = false;
+
+ThreadPool::ThreadPool(size_t workerCount) { start(workerCount); }
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::setWorkerCount(size_t workerCount) {
+  std::lock_guard submitLock(m_submitMutex);
+  stop();
+  start(workerCount);
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)> &task) {
+  if (count == 0)
+    return;
+
+  if (insideTask || m_workers.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i)
+      task(i);
+    return;
+  }
+
+  std::lock_guard submitLock(m_submitMutex);
+  {
+    std::lock_guard lock(m_mutex);
+    m_task = &task;
+    m_taskCount = count;
+    m_nextTask = 0;
+    m_busyWorkers = m_workers.size();
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  runTasks();
+
+  std::unique_lock lock(m_mutex);
+  m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+  m_task = nullptr;
+}
+
+void ThreadPool::start(size_t workerCount) {
+  if (workerCount == 0)
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+  m_stopping = false;
+  for (size_t i = 1; i < workerCount; ++i)
+    m_workers.emplace_back(&ThreadPool::workerLoop, this, m_generation);
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for (auto &worker : m_workers)
+    worker.join();
+  m_workers.clear();
+}
+
+void ThreadPool::workerLoop(uint64_t generation) {
+  while (true) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_wake.wait(lock, [&] {
+        return m_stopping || m_generation != generation;
+      });
+      if (m_stopping)
+        return;
+      generation = m_generation;
+    }
+
+    runTasks();
+
+    std::lock_guard lock(m_mutex);
+    if (--m_busyWorkers == 0)
+      m_done.notify_one();
+  }
+}
+
+void ThreadPool::runTasks() {
+  insideTask = true;
+  for (size_t i = m_nextTask++; i < m_taskCount; i = m_nextTask++)
+    (*m_task)(i);
+  insideTask = false;
+}
@@ -0,0 +1,205 @@
+#include "triangleStore.h"
+#include "utils.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+// Built into every x86-64 binary and picked at runtime
+#define SLICER_HAS_AVX2_KERNEL
+#endif
+
+void TriangleStore::clear() {
+  for (int i = 0; i < 3; ++i) {
+    x[i].clear();
+    y[i].clear();
+    z[i].clear();
+  }
+  yMin.clear();
+  yMax.clear();
+}
+
+void TriangleStore::reserve(size_t count) {
+  for (int i = 0; i < 3; ++i) {
+    x[i].reserve(count);
+    y[i].reserve(count);
+    z[i].reserve(count);
+  }
+  yMin.reserve(count);
+  yMax.reserve(count);
+}
+
+void TriangleStore::push_back(const glm::vec3 &v1, const glm::vec3 &v2,
+                              const glm::vec3 &v3) {
+  const std::array<glm::vec3, 3> corners{v1, v2, v3};
+  for (int i = 0; i < 3; ++i) {
+    x[i].push_back(corners[i].x);
+    y[i].push_back(corners[i].y);
+    z[i].push_back(corners[i].z);
+  }
+  yMin.push_back(std::min({v1.y, v2.y, v3.y}));
+  yMax.push_back(std::max({v1.y, v2.y, v3.y}));
+}
+
+// Intersects triangle `t` with the plane the same way the per-triangle loop
+// this store replaced did: differences in float, everything else in double,
+// and the segment runs from the first crossed edge to the last one.
+static void intersectTriangle(const TriangleStore &triangles, uint32_t t,
+                              double sliceHeight,
+                              std::vector<Line> &lineSegments) {
+  if (triangles.yMin[t] >= sliceHeight || triangles.yMax[t] <= sliceHeight)
+    return;
+
+  Line segment;
+  for (int e = 0; e < 3; ++e) {
+    const int n = (e + 1) % 3;
+    const float y1 = triangles.y[e][t];
+    const float y2 = triangles.y[n][t];
+    if ((y1 - sliceHeight) * (y2 - sliceHeight) > 0)
+      continue;
+
+    const float x1 = triangles.x[e][t];
+    const float z1 = triangles.z[e][t];
+    double factor = (sliceHeight - y1) / (y2 - y1);
+    segment.setNextPoint({x1 + factor * (triangles.x[n][t] - x1),
+                          z1 + factor * (triangles.z[n][t] - z1)});
+  }
+  if (distance(segment.p1, segment.p2) >= 1e-3)
+    lineSegments.push_back(segment);
+}
+
+#ifdef SLICER_HAS_AVX2_KERNEL
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+// Eight triangles at a time, given either as a list of ids or as a
+// contiguous range starting at `first` when `ids` is null. The arithmetic
+// mirrors intersectTriangle operation for operation (no fused multiply-add)
+// so both give bit-identical segments, in the same order.
+static void intersectBatchAVX2(const TriangleStore &triangles,
+                               const uint32_t *ids, uint32_t first,
+                               double sliceHeight,
+                               std::vector<Line> &lineSegments) {
+  const __m256i index =
+      ids ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ids))
+          : _mm256_setzero_si256();
+  auto load = [&](const std::vector<float> &lane) {
+    return ids ? _mm256_i32gather_ps(lane.data(), index, sizeof(float))
+               : _mm256_loadu_ps(lane.data() + first);
+  };
+
+  const __m256 heightF = _mm256_set1_ps(static_cast<float>(sliceHeight));
+  const __m256 yMin = load(triangles.yMin);
+  const __m256 yMax = load(triangles.yMax);
+  // Cheap float pre-test, the exact test happens in double below
+  if (_mm256_movemask_ps(
+          _mm256_and_ps(_mm256_cmp_ps(yMin, heightF, _CMP_LE_OQ),
+                        _mm256_cmp_ps(yMax, heightF, _CMP_GE_OQ))) == 0)
+    return;
+
+  __m256 x[3], y[3], z[3];
+  for (int i = 0; i < 3; ++i) {
+    x[i] = load(triangles.x[i]);
+    y[i] = load(triangles.y[i]);
+    z[i] = load(triangles.z[i]);
+  }
+
+  const __m256d height = _mm256_set1_pd(sliceHeight);
+  const __m256d zero = _mm256_setzero_pd();
+  alignas(32) std::array<double, 8> x1, z1, x2, z2;
+  int hits = 0;
+
+  for (int half = 0; half < 2; ++half) {
+    auto widen = [half](__m256 value) {
+      return _mm256_cvtps_pd(half == 0 ? _mm256_castps256_ps128(value)
+                                       : _mm256_extractf128_ps(value, 1));
+    };
+
+    const __m256d hit =
+        _mm256_and_pd(_mm256_cmp_pd(widen(yMin), height, _CMP_LT_OQ),
+                      _mm256_cmp_pd(widen(yMax), height, _CMP_GT_OQ));
+
+    __m256d ex[3], ez[3], crossed[3];
+    for (int e = 0; e < 3; ++e) {
+      const int n = (e + 1) % 3;
+      const __m256d y1 = widen(y[e]);
+      const __m256d y2 = widen(y[n]);
+      crossed[e] = _mm256_cmp_pd(_mm256_mul_pd(_mm256_sub_pd(y1, height),
+                                               _mm256_sub_pd(y2, height)),
+                                 zero, _CMP_NGT_UQ);
+
+      const __m256d factor = _mm256_div_pd(_mm256_sub_pd(height, y1),
+                                           widen(_mm256_sub_ps(y[n], y[e])));
+      ex[e] = _mm256_add_pd(
+          widen(x[e]),
+          _mm256_mul_pd(factor, widen(_mm256_sub_ps(x[n], x[e]))));
+      ez[e] = _mm256_add_pd(
+          widen(z[e]),
+          _mm256_mul_pd(factor, widen(_mm256_sub_ps(z[n], z[e]))));
+    }
+
+    auto firstEdge = [&](const __m256d *v) {
+      return _mm256_blendv_pd(_mm256_blendv_pd(v[2], v[1], crossed[1]), v[0],
+                              crossed[0]);
+    };
+    auto lastEdge = [&](const __m256d *v) {
+      return _mm256_blendv_pd(_mm256_blendv_pd(v[0], v[1], crossed[1]), v[2],
+                              crossed[2]);
+    };
+    _mm256_store_pd(x1.data() + half * 4, firstEdge(ex));
+    _mm256_store_pd(z1.data() + half * 4, firstEdge(ez));
+    _mm256_store_pd(x2.data() + half * 4, lastEdge(ex));
+    _mm256_store_pd(z2.data() + half * 4, lastEdge(ez));
+    hits |= _mm256_movemask_pd(hit) << (half * 4);
+  }
+
+  for (int k = 0; k < 8; ++k) {
+    if (!(hits & (1 << k)))
+      continue;
+    Line segment;
+    segment.setNextPoint({x1[k], z1[k]});
+    segment.setNextPoint({x2[k], z2[k]});
+    if (distance(segment.p1, segment.p2) >= 1e-3)
+      lineSegments.push_back(segment);
+  }
+}
+
+#pragma GCC pop_options
+#endif
+
+IntersectKernel getIntersectKernel() {
+#ifdef SLICER_HAS_AVX2_KERNEL
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2)
+    return IntersectKernel::AVX2;
+#endif
+  return IntersectKernel::Scalar;
+}
+
+void intersectTriangles(IntersectKernel kernel, const TriangleStore &triangles,
+                        const uint32_t *ids, size_t count, double sliceHeight,
+                        std::vector<Line> &lineSegments) {
+  size_t i = 0;
+#ifdef SLICER_HAS_AVX2_KERNEL
+  if (kernel == IntersectKernel::AVX2)
+    for (; i + 8 <= count; i += 8)
+      intersectBatchAVX2(triangles, ids ? ids + i : nullptr,
+                         static_cast<uint32_t>(i), sliceHeight, lineSegments);
+#endif
+  for (; i < count; ++i)
+    intersectTriangle(triangles, ids ? ids[i] : static_cast<uint32_t>(i),
+                      sliceHeight, lineSegments);
+}
+
+void intersectTriangles(const TriangleStore &triangles, const uint32_t *ids,
+                        size_t count, double sliceHeight,
+                        std::vector<Line> &lineSegments) {
+  intersectTriangles(getIntersectKernel(), triangles, ids, count, sliceHeight,
+                     lineSegments);
+}
+
+void intersectTriangles(const TriangleStore &triangles, double sliceHeight,
+                        std::vector<Line> &lineSegments) {
+  intersectTriangles(getIntersectKernel(), triangles, nullptr,
+                     triangles.size(), sliceHeight, lineSegments);
+}
@@ -0,0 +1,109 @@
+#include "vertexWelder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+struct CellKey {
+  std::array<int32_t, 3> cell;
+
+  bool operator==(const CellKey &other) const = default;
+};
+
+struct CellKeyHash {
+  size_t operator()(const CellKey &key) const {
+    uint64_t hash = 14695981039346656037ull;
+    for (int32_t coordinate : key.cell)
+      hash = (hash ^ static_cast<uint32_t>(coordinate)) * 1099511628211ull;
+    return hash;
+  }
+};
+
+void weldVertices(const std::vector<glm::vec3> &positions, float tolerance,
+                  ThreadPool &threadPool, std::vector<uint32_t> &ids,
+                  std::vector<uint32_t> &firstVertex) {
+  const size_t count = positions.size();
+  ids.resize(count);
+  firstVertex.clear();
+  if (count == 0)
+    return;
+
+  // Every worker quantizes a contiguous chunk and sorts its vertices into
+  // shards by hash, so each shard can be welded by one worker without locks
+  const size_t chunkCount = std::min(threadPool.getWorkerCount(), count);
+  const size_t shardCount = chunkCount;
+  std::vector<CellKey> keys(count);
+  std::vector<std::vector<std::vector<uint32_t>>> buckets(
+      chunkCount, std::vector<std::vector<uint32_t>>(shardCount));
+
+  threadPool.parallelFor(chunkCount, [&](size_t chunk) {
+    const size_t begin = count * chunk / chunkCount;
+    const size_t end = count * (chunk + 1) / chunkCount;
+    for (auto &bucket : buckets[chunk])
+      bucket.reserve((end - begin) / shardCount + 1);
+
+    for (size_t i = begin; i < end; ++i) {
+      for (int j = 0; j < 3; ++j)
+        keys[i].cell[j] = static_cast<int32_t>(
+            std::lround(positions[i][j] / tolerance));
+      buckets[chunk][CellKeyHash()(keys[i]) % shardCount].push_back(i);
+    }
+  });
+
+  // Walking the chunks in order visits a shard's vertices in input order, so
+  // the first vertex seen in a cell represents it
+  std::vector<std::unordered_map<CellKey, uint32_t, CellKeyHash>> cells(
+      shardCount);
+  std::vector<uint32_t> representative(count);
+  threadPool.parallelFor(shardCount, [&](size_t shard) {
+    size_t shardSize = 0;
+    for (const auto &chunkBuckets : buckets)
+      shardSize += chunkBuckets[shard].size();
+
+    cells[shard].reserve(shardSize);
+    for (const auto &chunkBuckets : buckets)
+      for (uint32_t i : chunkBuckets[shard])
+        representative[i] = cells[shard].try_emplace(keys[i], i).first->second;
+  });
+
+  // Positions within `tolerance` of each other can still round into
+  // neighbouring cells. Every representative is linked to the earliest
+  // representative of the surrounding cells that is close enough, the cell
+  // maps are only read from here on.
+  const float toleranceSquared = tolerance * tolerance;
+  std::vector<uint32_t> link(count);
+  threadPool.parallelFor(shardCount, [&](size_t shard) {
+    for (const auto &[key, vertex] : cells[shard]) {
+      uint32_t target = vertex;
+      for (int dx = -1; dx <= 1; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+          for (int dz = -1; dz <= 1; ++dz) {
+            const CellKey neighbour{
+                {key.cell[0] + dx, key.cell[1] + dy, key.cell[2] + dz}};
+            const auto &neighbourCells =
+                cells[CellKeyHash()(neighbour) % shardCount];
+            auto it = neighbourCells.find(neighbour);
+            if (it == neighbourCells.end() || it->second >= target)
+              continue;
+            const glm::vec3 offset = positions[it->second] - positions[vertex];
+            if (glm::dot(offset, offset) <= toleranceSquared)
+              target = it->second;
+          }
+      link[vertex] = target;
+    }
+  });
+
+  // Representatives and their links always point backwards, so one pass
+  // numbers the welded vertices in order
+  for (uint32_t i = 0; i < count; ++i) {
+    if (representative[i] != i) {
+      ids[i] = ids[representative[i]];
+    } else if (link[i] != i) {
+      ids[i] = ids[link[i]];
+    } else {
+      ids[i] = firstVertex.size();
+      firstVertex.push_back(i);
+    }
+  }
+}
@@ -0,0 +1,250 @@
+#include "workspace.h"
+
+#include <Nexus.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace Clipper2Lib;
+
+// Allocations made by the current thread, updated by the replaced global
+// operator new and delete when built with SLICER_ALLOC_STATS
+static thread_local uint64_t t_allocations = 0;
+static thread_local uint64_t t_allocatedBytes = 0;
+static thread_local int64_t t_liveBytes = 0;
+static thread_local int64_t t_peakBytes = 0;
+
+#ifdef SLICER_ALLOC_STATS
+// Every block is prefixed with its size so delete knows what is freed. The
+// prefix is as large as the block's alignment, so the pointer handed out
+// keeps it.
+static constexpr size_t DEFAULT_ALIGNMENT = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+static void *allocate(size_t size, size_t alignment) noexcept {
+  alignment = std::max(alignment, DEFAULT_ALIGNMENT);
+  void *memory;
+  if (alignment == DEFAULT_ALIGNMENT) {
+    memory = std::malloc(size + alignment);
+  } else {
+    // aligned_alloc wants a multiple of the alignment
+    memory = std::aligned_alloc(
+        alignment, (size + 2 * alignment - 1) / alignment * alignment);
+  }
+  if (!memory)
+    return nullptr;
+
+  auto *block = static_cast<std::byte *>(memory);
+  *reinterpret_cast<size_t *>(block) = size;
+  ++t_allocations;
+  t_allocatedBytes += size;
+  t_liveBytes += static_cast<int64_t>(size);
+  t_peakBytes = std::max(t_peakBytes, t_liveBytes);
+  return block + alignment;
+}
+
+static void deallocate(void *pointer, size_t alignment) noexcept {
+  if (!pointer)
+    return;
+  auto *block = static_cast<std::byte *>(pointer) -
+                std::max(alignment, DEFAULT_ALIGNMENT);
+  t_liveBytes -= static_cast<int64_t>(*reinterpret_cast<size_t *>(block));
+  std::free(block);
+}
+
+static void *allocateOrThrow(size_t size, size_t alignment) {
+  void *pointer = allocate(size, alignment);
+  if (!pointer)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void *operator new(size_t size) {
+  return allocateOrThrow(size, DEFAULT_ALIGNMENT);
+}
+void *operator new[](size_t size) {
+  return allocateOrThrow(size, DEFAULT_ALIGNMENT);
+}
+void *operator new(size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size, DEFAULT_ALIGNMENT);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size, DEFAULT_ALIGNMENT);
+}
+void *operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void *pointer) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete(void *pointer, size_t) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void *pointer, size_t) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer, DEFAULT_ALIGNMENT);
+}
+void operator delete(void *pointer, std::align_val_t alignment) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+void operator delete(void *pointer, size_t,
+                     std::align_val_t alignment) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, size_t,
+                       std::align_val_t alignment) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+void operator delete(void *pointer, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, std::align_val_t alignment,
+                       const std::nothrow_t &) noexcept {
+  deallocate(pointer, static_cast<size_t>(alignment));
+}
+#endif
+
+void Arena::reset() {
+  // Merge the blocks so the next layer of the same size fits in one
+  if (m_blocks.size() > 1) {
+    size_t size = 0;
+    for (const auto &block : m_blocks)
+      size += block.size;
+    m_blocks.clear();
+    m_blocks.push_back(
+        {std::make_unique_for_overwrite<std::byte[]>(size), size});
+  }
+  m_offset = 0;
+  m_used = 0;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  auto alignedOffset = [&](const Block &block) {
+    const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+    return (base + m_offset + alignment - 1) / alignment * alignment - base;
+  };
+
+  if (m_blocks.empty() ||
+      alignedOffset(m_blocks.back()) + bytes > m_blocks.back().size) {
+    const size_t previous = m_blocks.empty() ? 0 : m_blocks.back().size;
+    const size_t size =
+        std::max({MIN_BLOCK_SIZE, bytes + alignment, previous * 2});
+    m_blocks.push_back(
+        {std::make_unique_for_overwrite<std::byte[]>(size), size});
+    m_offset = 0;
+  }
+
+  auto &block = m_blocks.back();
+  const size_t offset = alignedOffset(block);
+  m_offset = offset + bytes;
+  m_used += bytes;
+  return block.data.get() + offset;
+}
+
+Workspace &Workspace::get() {
+  thread_local Workspace workspace;
+  return workspace;
+}
+
+Paths64 Workspace::clip(ClipType clipType, FillRule fillRule,
+                        const Paths64 &subject, const Paths64 &clip) {
+  clipper.Clear();
+  clipper.AddSubject(subject);
+  clipper.AddClip(clip);
+  Paths64 result;
+  clipper.Execute(clipType, fillRule, result);
+  return result;
+}
+
+Paths64 Workspace::inflate(const Paths64 &paths, double delta,
+                           JoinType joinType, EndType endType) {
+  offset.Clear();
+  offset.AddPaths(paths, joinType, endType);
+  Paths64 result;
+  offset.Execute(delta, result);
+  return result;
+}
+
+static void updateMax(std::atomic<uint64_t> &value, uint64_t candidate) {
+  uint64_t current = value.load(std::memory_order_relaxed);
+  while (candidate > current &&
+         !value.compare_exchange_weak(current, candidate))
+    ;
+}
+
+LayerScope::LayerScope(StageCounters *counters, Stage stage)
+    : m_counters(counters), m_stage(stage),
+      m_outermost(Workspace::get().layerDepth++ == 0),
+      m_allocations(t_allocations), m_allocatedBytes(t_allocatedBytes),
+      m_liveBytes(t_liveBytes) {
+  if (!m_outermost)
+    return;
+  Workspace::get().arena.reset();
+  t_peakBytes = t_liveBytes;
+}
+
+LayerScope::~LayerScope() {
+  auto &workspace = Workspace::get();
+  --workspace.layerDepth;
+  if (!m_outermost || !m_counters)
+    return;
+
+  auto &counters = m_counters->m_stages[static_cast<size_t>(m_stage)];
+  counters.layers.fetch_add(1, std::memory_order_relaxed);
+  counters.allocations.fetch_add(t_allocations - m_allocations,
+                                 std::memory_order_relaxed);
+  counters.allocatedBytes.fetch_add(t_allocatedBytes - m_allocatedBytes,
+                                    std::memory_order_relaxed);
+  const int64_t peakBytes = std::max<int64_t>(t_peakBytes - m_liveBytes, 0);
+  updateMax(counters.peakBytes, static_cast<uint64_t>(peakBytes));
+  updateMax(counters.arenaPeakBytes, workspace.arena.getUsedBytes());
+}
+
+StageStats StageCounters::get(Stage stage) const {
+  const auto &counters = m_stages[static_cast<size_t>(stage)];
+  return {counters.layers.load(), counters.allocations.load(),
+          counters.allocatedBytes.load(), counters.peakBytes.load(),
+          counters.arenaPeakBytes.load()};
+}
+
+void StageCounters::log(Stage stage) {
+  const StageStats stats = get(stage);
+  Nexus::Logger::debug(
+      "{}: {} layers, {} allocations ({} KB), peak {} KB per layer, arena "
+      "peak {} KB",
+      getStageName(stage), stats.layers, stats.allocations,
+      stats.allocatedBytes / 1024, stats.peakBytes / 1024,
+      stats.arenaPeakBytes / 1024);
+
+  auto &counters = m_stages[static_cast<size_t>(stage)];
+  counters.layers = 0;
+  counters.allocations = 0;
+  counters.allocatedBytes = 0;
+  counters.peakBytes = 0;
+  counters.arenaPeakBytes = 0;
+}